@@ -102,6 +102,11 @@ workspace "open-iw5"
 			"./src/resources/**.*"
 		}
 
+		removefiles {
+			"./src/dw-server/**",
+			"./src/dw-load/**"
+		}
+
 		includedirs {
 			"./src"
 		}
@@ -118,5 +123,67 @@ workspace "open-iw5"
 
 		dependencies.imports()
 
+	project "dw-server"
+		kind "ConsoleApp"
+		language "C++"
+
+		pchheader "std_include.hpp"
+		pchsource "src/dw-server/std_include.cpp"
+
+		-- The publisher files served by bdStorage are embedded as resources
+		files {
+			"./src/resource.rc",
+			"./src/resources/**.*",
+			"./src/dw-server/**.hpp",
+			"./src/dw-server/**.cpp",
+			"./src/game/demonware/**.hpp",
+			"./src/game/demonware/**.cpp",
+			"./src/steam/**.hpp",
+			"./src/steam/**.cpp",
+			"./src/utils/**.hpp",
+			"./src/utils/**.cpp"
+		}
+
+		includedirs {
+			"./src"
+		}
+
+		resincludedirs {
+			"$(ProjectDir)src"
+		}
+
+		dependencies.imports()
+
+	-- Drives simulated clients against an in-process core or a running dw-server
+	project "dw-load"
+		kind "ConsoleApp"
+		language "C++"
+
+		pchheader "std_include.hpp"
+		pchsource "src/dw-load/std_include.cpp"
+
+		files {
+			"./src/resource.rc",
+			"./src/resources/**.*",
+			"./src/dw-load/**.hpp",
+			"./src/dw-load/**.cpp",
+			"./src/game/demonware/**.hpp",
+			"./src/game/demonware/**.cpp",
+			"./src/steam/**.hpp",
+			"./src/steam/**.cpp",
+			"./src/utils/**.hpp",
+			"./src/utils/**.cpp"
+		}
+
+		includedirs {
+			"./src"
+		}
+
+		resincludedirs {
+			"$(ProjectDir)src"
+		}
+
+		dependencies.imports()
+
 	group "Dependencies"
 		dependencies.projects()
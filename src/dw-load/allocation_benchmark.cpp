@@ -0,0 +1,81 @@
+#include <std_include.hpp>
+#include "allocation_benchmark.hpp"
+#include "allocation_counter.hpp"
+#include "client.hpp"
+#include "game/demonware/core.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr size_t warmup_requests = 16;
+
+		// Runs requests of one kind back to back until enough completed or time is up
+		bool run_requests(client& client, const request_kind kind, const size_t count,
+		                  const std::chrono::high_resolution_clock::time_point end, size_t* completed)
+		{
+			const auto next_request = [kind]()
+			{
+				return kind;
+			};
+
+			std::vector<client::completion> completions;
+			while (*completed < count && std::chrono::high_resolution_clock::now() < end)
+			{
+				if (!client.update(next_request, &completions)) return false;
+
+				*completed += completions.size();
+				completions.clear();
+
+				std::this_thread::yield();
+			}
+
+			return true;
+		}
+	}
+
+	void run_allocation_benchmark(const std::chrono::seconds duration)
+	{
+		// Only what the emulator allocates is of interest, not the client building and parsing frames
+		ignore_thread_allocations();
+
+		core::settings settings{};
+		settings.worker_count = 1;
+		settings.storage_directory = "dw-load/allocations";
+
+		core core(settings);
+		core.register_default_servers();
+
+		const auto server = core.find_server_by_name("mw3-pc-lobby.prod.demonware.net");
+		client client(std::make_unique<session_transport>(server->create_session()), 1);
+
+		printf("Emulator allocations per handled request, %zus per request kind\n", static_cast<size_t>(duration.count()));
+		printf("%24s %12s %16s\n", "request", "requests", "allocations");
+
+		for (const auto& info : get_request_infos())
+		{
+			// Fills the storage cache and the lookups done on first use
+			size_t completed = 0;
+			if (!run_requests(client, info.kind, warmup_requests, std::chrono::high_resolution_clock::now() + 5s,
+			                  &completed))
+			{
+				printf("Lost the connection\n");
+				return;
+			}
+
+			completed = 0;
+			const auto allocations = get_allocation_count();
+			const auto end = std::chrono::high_resolution_clock::now() + duration;
+
+			if (!run_requests(client, info.kind, SIZE_MAX, end, &completed))
+			{
+				printf("Lost the connection\n");
+				return;
+			}
+
+			// One request is always in flight at either end, which evens out
+			const auto count = get_allocation_count() - allocations;
+			printf("%24s %12zu %16.1f\n", info.name, completed, completed ? static_cast<double>(count) / completed : 0.0);
+		}
+	}
+}
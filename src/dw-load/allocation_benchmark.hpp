@@ -0,0 +1,7 @@
+#pragma once
+
+namespace demonware
+{
+	// Heap allocations the in-process emulator makes per handled request, for every request kind
+	void run_allocation_benchmark(std::chrono::seconds duration);
+}
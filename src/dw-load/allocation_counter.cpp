@@ -0,0 +1,74 @@
+#include <std_include.hpp>
+#include "allocation_counter.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		std::atomic<uint64_t> allocation_count{0};
+		thread_local bool ignored = false;
+
+		void count_allocation()
+		{
+			if (!ignored)
+			{
+				allocation_count.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	uint64_t get_allocation_count()
+	{
+		return allocation_count.load();
+	}
+
+	void ignore_thread_allocations()
+	{
+		ignored = true;
+	}
+}
+
+// The array and nothrow forms end up in these
+void* operator new(const size_t size)
+{
+	demonware::count_allocation();
+
+	if (auto* memory = std::malloc(size ? size : 1))
+	{
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment)
+{
+	demonware::count_allocation();
+
+	if (auto* memory = _aligned_malloc(size ? size : 1, static_cast<size_t>(alignment)))
+	{
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	_aligned_free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(memory);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace demonware
+{
+	// Every operator new in this process is counted, except on threads that opted out.
+	// Lets the benchmarks attribute allocations to the emulator instead of the simulated clients.
+	uint64_t get_allocation_count();
+	void ignore_thread_allocations();
+}
@@ -0,0 +1,383 @@
+#include <std_include.hpp>
+#include "bit_buffer_benchmark.hpp"
+#include "game/demonware/bit_buffer.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr size_t check_iterations = 20000;
+		constexpr size_t max_operations = 64;
+
+		// bit_buffer as it was before the word at a time kernels
+		class reference_bit_buffer final
+		{
+		public:
+			reference_bit_buffer() = default;
+
+			explicit reference_bit_buffer(std::string buffer) : buffer_(std::move(buffer))
+			{
+			}
+
+			bool read_bytes(const unsigned int bytes, unsigned char* output)
+			{
+				return this->read(bytes * 8, output);
+			}
+
+			bool read_bool(bool* output)
+			{
+				if (!this->read_data_type(1)) return false;
+				return this->read(1, output);
+			}
+
+			bool read_uint32(unsigned int* output)
+			{
+				if (!this->read_data_type(8)) return false;
+				return this->read(32, output);
+			}
+
+			bool read_data_type(const char expected)
+			{
+				char data_type = 0;
+
+				if (!this->use_data_types_) return true;
+				if (this->read(5, &data_type))
+				{
+					return (data_type == expected);
+				}
+
+				return false;
+			}
+
+			bool write_bytes(const unsigned int bytes, const unsigned char* data)
+			{
+				return this->write(bytes * 8, data);
+			}
+
+			bool write_bool(bool data)
+			{
+				if (this->write_data_type(1)) return this->write(1, &data);
+				return false;
+			}
+
+			bool write_int32(int data)
+			{
+				if (this->write_data_type(7)) return this->write(32, &data);
+				return false;
+			}
+
+			bool write_uint32(unsigned int data)
+			{
+				if (this->write_data_type(8)) return this->write(32, &data);
+				return false;
+			}
+
+			bool write_data_type(char data)
+			{
+				if (!this->use_data_types_) return true;
+				return this->write(5, &data);
+			}
+
+			bool read(unsigned int bits, void* output)
+			{
+				if (bits == 0) return false;
+				if ((this->current_bit_ + bits) > (this->buffer_.size() * 8)) return false;
+
+				int cur_byte = this->current_bit_ >> 3;
+				auto cur_out = 0;
+
+				const char* bytes = this->buffer_.data();
+				const auto output_bytes = reinterpret_cast<unsigned char*>(output);
+
+				while (bits > 0)
+				{
+					const int min_bit = (bits < 8) ? bits : 8;
+					const auto this_byte = bytes[cur_byte++] & 0xFF;
+					const int remain = this->current_bit_ & 7;
+
+					if ((min_bit + remain) <= 8)
+					{
+						output_bytes[cur_out] = BYTE((0xFF >> (8 - min_bit)) & (this_byte >> remain));
+					}
+					else
+					{
+						output_bytes[cur_out] = BYTE(
+							(0xFF >> (8 - min_bit)) & (bytes[cur_byte] << (8 - remain)) | (this_byte >> remain));
+					}
+
+					cur_out++;
+					this->current_bit_ += min_bit;
+					bits -= min_bit;
+				}
+
+				return true;
+			}
+
+			bool write(const unsigned int bits, const void* data)
+			{
+				if (bits == 0) return false;
+				this->buffer_.resize(this->buffer_.size() + (bits >> 3) + 1);
+
+				int bit = bits;
+				const auto bytes = const_cast<char*>(this->buffer_.data());
+				const auto* input_bytes = reinterpret_cast<const unsigned char*>(data);
+
+				while (bit > 0)
+				{
+					const int bit_pos = this->current_bit_ & 7;
+					auto rem_bit = 8 - bit_pos;
+					const auto this_write = (bit < rem_bit) ? bit : rem_bit;
+
+					const BYTE mask = ((0xFF >> rem_bit) | (0xFF << (bit_pos + this_write)));
+					const int byte_pos = this->current_bit_ >> 3;
+
+					const BYTE temp_byte = (mask & bytes[byte_pos]);
+					const BYTE this_bit = ((bits - bit) & 7);
+					const auto this_byte = (bits - bit) >> 3;
+
+					auto this_data = input_bytes[this_byte];
+
+					const auto next_byte = (((bits - 1) >> 3) > this_byte) ? input_bytes[this_byte + 1] : 0;
+
+					this_data = BYTE((next_byte << (8 - this_bit)) | (this_data >> this_bit));
+
+					const BYTE out_byte = (~mask & (this_data << bit_pos) | temp_byte);
+					bytes[byte_pos] = out_byte;
+
+					this->current_bit_ += this_write;
+					bit -= this_write;
+				}
+
+				return true;
+			}
+
+			void set_use_data_types(const bool use_data_types)
+			{
+				this->use_data_types_ = use_data_types;
+			}
+
+			std::string& get_buffer()
+			{
+				this->buffer_.resize(this->current_bit_ / 8 + (this->current_bit_ % 8 ? 1 : 0));
+				return this->buffer_;
+			}
+
+		private:
+			std::string buffer_{};
+			unsigned int current_bit_ = 0;
+			bool use_data_types_ = true;
+		};
+
+		enum class operation_type
+		{
+			raw,
+			bytes,
+			boolean,
+			int32,
+			uint32,
+			data_types,
+		};
+
+		struct operation
+		{
+			operation_type type;
+			unsigned int bits;
+			std::array<unsigned char, 64> data;
+		};
+
+		std::vector<operation> generate_operations(std::mt19937& generator)
+		{
+			std::uniform_int_distribution<size_t> count(1, max_operations);
+			std::uniform_int_distribution<int> type(0, static_cast<int>(operation_type::data_types));
+			std::uniform_int_distribution<unsigned int> raw_bits(1, 64 * 8);
+			std::uniform_int_distribution<unsigned int> byte_count(1, 64);
+			std::uniform_int_distribution<int> byte(0, 255);
+
+			std::vector<operation> operations(count(generator));
+			for (auto& operation : operations)
+			{
+				operation.type = static_cast<operation_type>(type(generator));
+				operation.bits = operation.type == operation_type::raw ? raw_bits(generator) : byte_count(generator) * 8;
+
+				for (auto& value : operation.data)
+				{
+					value = static_cast<unsigned char>(byte(generator));
+				}
+			}
+
+			return operations;
+		}
+
+		template <typename Buffer>
+		std::vector<bool> write_operations(Buffer& buffer, const std::vector<operation>& operations)
+		{
+			std::vector<bool> results;
+			for (const auto& operation : operations)
+			{
+				const auto* data = operation.data.data();
+
+				switch (operation.type)
+				{
+				case operation_type::raw:
+					results.push_back(buffer.write(operation.bits, data));
+					break;
+				case operation_type::bytes:
+					results.push_back(buffer.write_bytes(operation.bits / 8, data));
+					break;
+				case operation_type::boolean:
+					results.push_back(buffer.write_bool(data[0] & 1));
+					break;
+				case operation_type::int32:
+					results.push_back(buffer.write_int32(*reinterpret_cast<const int*>(data)));
+					break;
+				case operation_type::uint32:
+					results.push_back(buffer.write_uint32(*reinterpret_cast<const unsigned int*>(data)));
+					break;
+				case operation_type::data_types:
+					buffer.set_use_data_types(data[0] & 1);
+					break;
+				}
+			}
+
+			return results;
+		}
+
+		// Returns the results and every value read, reads past the end have to fail the same way
+		template <typename Buffer>
+		std::pair<std::vector<bool>, std::string> read_operations(Buffer& buffer,
+		                                                          const std::vector<operation>& operations)
+		{
+			std::vector<bool> results;
+			std::string values;
+
+			for (const auto& operation : operations)
+			{
+				std::array<unsigned char, 64> output{};
+				auto size = sizeof(uint32_t);
+
+				switch (operation.type)
+				{
+				case operation_type::raw:
+					results.push_back(buffer.read(operation.bits, output.data()));
+					size = (operation.bits + 7) / 8;
+					break;
+				case operation_type::bytes:
+					results.push_back(buffer.read_bytes(operation.bits / 8, output.data()));
+					size = operation.bits / 8;
+					break;
+				case operation_type::boolean:
+				{
+					bool value{};
+					results.push_back(buffer.read_bool(&value));
+					output[0] = value;
+					break;
+				}
+				case operation_type::int32:
+				case operation_type::uint32:
+					results.push_back(buffer.read_uint32(reinterpret_cast<unsigned int*>(output.data())));
+					break;
+				case operation_type::data_types:
+					buffer.set_use_data_types(operation.data[0] & 1);
+					continue;
+				}
+
+				if (results.back()) values.append(reinterpret_cast<const char*>(output.data()), size);
+			}
+
+			return {results, values};
+		}
+
+		template <typename Buffer>
+		double measure(const std::vector<operation>& operations, const std::chrono::seconds duration)
+		{
+			uint64_t bytes = 0;
+			const auto start = std::chrono::high_resolution_clock::now();
+			auto now = start;
+
+			while (now - start < duration)
+			{
+				Buffer writer;
+				write_operations(writer, operations);
+
+				Buffer reader(writer.get_buffer());
+				read_operations(reader, operations);
+
+				bytes += writer.get_buffer().size() * 2;
+				now = std::chrono::high_resolution_clock::now();
+			}
+
+			const std::chrono::duration<double> elapsed = now - start;
+			return static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed.count();
+		}
+	}
+
+	bool run_bit_buffer_check()
+	{
+		std::mt19937 generator(1337);
+
+		for (size_t i = 0; i < check_iterations; ++i)
+		{
+			const auto operations = generate_operations(generator);
+
+			reference_bit_buffer reference_writer;
+			bit_buffer writer;
+
+			if (write_operations(reference_writer, operations) != write_operations(writer, operations)
+				|| reference_writer.get_buffer() != writer.get_buffer())
+			{
+				printf("Written streams differ in iteration %zu\n", i);
+				return false;
+			}
+
+			// Reading the stream back with a shuffled schedule also covers failed and misaligned reads
+			auto read_schedule = operations;
+			std::shuffle(read_schedule.begin(), read_schedule.end(), generator);
+
+			reference_bit_buffer reference_reader(writer.get_buffer());
+			bit_buffer reader(writer.get_buffer());
+
+			if (read_operations(reference_reader, read_schedule) != read_operations(reader, read_schedule))
+			{
+				printf("Read values differ in iteration %zu\n", i);
+				return false;
+			}
+		}
+
+		printf("%zu random write and read sequences match the reference\n", check_iterations);
+		return true;
+	}
+
+	void run_bit_buffer_benchmark(const std::chrono::seconds duration)
+	{
+		if (!run_bit_buffer_check()) return;
+
+		std::mt19937 generator(1337);
+
+		// What bdLSGHello and the DML replies look like: typed fields around a byte blob
+		std::vector<operation> fields;
+		for (auto i = 0; i < 16; ++i)
+		{
+			auto field = generate_operations(generator);
+			fields.insert(fields.end(), field.begin(), field.end());
+		}
+
+		std::vector<operation> blobs(64);
+		for (auto& blob : blobs)
+		{
+			blob.type = operation_type::bytes;
+			blob.bits = 64 * 8;
+		}
+
+		printf("bit_buffer write and read back, %zus per run\n", static_cast<size_t>(duration.count()));
+		printf("%10s %16s %16s %8s\n", "stream", "old MB/s", "new MB/s", "speedup");
+
+		for (const auto& run : {std::make_pair("fields", &fields), std::make_pair("blobs", &blobs)})
+		{
+			const auto old_throughput = measure<reference_bit_buffer>(*run.second, duration);
+			const auto throughput = measure<bit_buffer>(*run.second, duration);
+
+			printf("%10s %16.1f %16.1f %7.1fx\n", run.first, old_throughput, throughput,
+			       old_throughput > 0 ? throughput / old_throughput : 0.0);
+		}
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace demonware
+{
+	// Runs random reads and writes through bit_buffer and the byte at a time
+	// implementation it replaced, the streams and values have to match exactly
+	bool run_bit_buffer_check();
+
+	// Throughput of both implementations for typed fields and byte-aligned blobs
+	void run_bit_buffer_benchmark(std::chrono::seconds duration);
+}
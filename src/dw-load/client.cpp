@@ -0,0 +1,256 @@
+#include <std_include.hpp>
+#include "client.hpp"
+#include "game/demonware/i_server.hpp"
+#include "utils/string.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr auto publisher_file = "motd-english.txt";
+		constexpr size_t user_file_size = 1024;
+	}
+
+	const std::vector<request_info>& get_request_infos()
+	{
+		static const std::vector<request_info> infos
+		{
+			{request_kind::server_time, "server_time", 12, 6},
+			{request_kind::user_raw_data, "user_raw_data", 27, 2},
+			{request_kind::publisher_file, "publisher_file", 10, 7},
+			{request_kind::list_publisher_files, "list_publisher_files", 10, 6},
+			{request_kind::get_user_file, "get_user_file", 10, 12},
+			{request_kind::set_user_file, "set_user_file", 10, 10},
+		};
+
+		return infos;
+	}
+
+	const request_info& get_request_info(const request_kind kind)
+	{
+		return get_request_infos()[static_cast<size_t>(kind)];
+	}
+
+	client::client(std::unique_ptr<transport> transport, const uint64_t id) : transport_(std::move(transport)), id_(id)
+	{
+	}
+
+	uint64_t client::get_id() const
+	{
+		return this->id_;
+	}
+
+	transport& client::get_transport() const
+	{
+		return *this->transport_;
+	}
+
+	bool client::update(const std::function<request_kind()>& next_request, std::vector<completion>* completions)
+	{
+		if (this->state_ == state::connecting)
+		{
+			// Connection id request
+			byte_buffer buffer;
+			buffer.set_use_data_types(false);
+			buffer.write_int32(200);
+
+			if (!this->transport_->send(buffer.get_buffer())) return false;
+			this->state_ = state::handshake;
+		}
+
+		if (!this->transport_->receive(&this->receive_buffer_)) return false;
+
+		std::string frame;
+		while (this->read_frame(&frame))
+		{
+			if (!this->handle_frame(frame, completions)) return false;
+		}
+
+		if (this->state_ != state::idle) return true;
+
+		// Every client writes its own file first, so reading it back can't fail
+		if (!this->seeded_)
+		{
+			this->seeded_ = true;
+			return this->send_request(request_kind::set_user_file, false);
+		}
+
+		return this->send_request(next_request(), true);
+	}
+
+	std::string client::get_user_filename() const
+	{
+		return utils::string::va("dw-load-%llu.dat", this->id_);
+	}
+
+	bool client::send_hello()
+	{
+		std::mt19937 generator(static_cast<uint32_t>(this->id_));
+
+		uint8_t ticket[128];
+		for (auto& byte : ticket)
+		{
+			byte = static_cast<uint8_t>(generator());
+		}
+
+		// The lobby server keys the connection with the ticket
+		this->crypto_.set_key(true, ticket);
+		this->crypto_.set_key(false, ticket);
+
+		bit_buffer buffer;
+		buffer.set_use_data_types(false);
+		buffer.write_bool(false);
+		buffer.set_use_data_types(true);
+		buffer.write_uint32(0); // title id
+		buffer.write_uint32(generator()); // seed
+		buffer.write_bytes(sizeof(ticket), ticket);
+
+		unencrypted_reply hello(7, &buffer);
+		if (!this->transport_->send(hello.get_data())) return false;
+
+		// bdLSGHello isn't answered
+		this->state_ = state::idle;
+		return true;
+	}
+
+	bool client::send_request(const request_kind kind, const bool recorded)
+	{
+		const auto& info = get_request_info(kind);
+
+		byte_buffer payload;
+		payload.write_byte(static_cast<char>(info.sub_type));
+
+		switch (kind)
+		{
+		case request_kind::server_time:
+		case request_kind::user_raw_data:
+			break;
+		case request_kind::publisher_file:
+			payload.write_string(publisher_file);
+			break;
+		case request_kind::list_publisher_files:
+			payload.write_uint32(0); // date
+			payload.write_uint16(10); // num results
+			payload.write_uint16(0); // offset
+			payload.write_string(publisher_file);
+			break;
+		case request_kind::get_user_file:
+			payload.write_string("iw5");
+			payload.write_string(this->get_user_filename());
+			payload.write_uint64(this->id_);
+			payload.write_string("pc");
+			break;
+		case request_kind::set_user_file:
+		{
+			// Distinct contents, otherwise the storage would deduplicate every write
+			std::string data(user_file_size, static_cast<char>(this->id_));
+			const auto write = this->writes_++;
+			std::memcpy(data.data(), &this->id_, sizeof(this->id_));
+			std::memcpy(data.data() + sizeof(this->id_), &write, sizeof(write));
+
+			payload.write_string("iw5");
+			payload.write_string(this->get_user_filename());
+			payload.write_bool(false);
+			payload.write_blob(data);
+			payload.write_uint64(this->id_);
+			break;
+		}
+		}
+
+		encrypted_reply request(info.type, &payload, this->crypto_);
+		auto data = request.get_data();
+
+		this->state_ = state::waiting;
+		this->pending_kind_ = kind;
+		this->pending_recorded_ = recorded;
+		this->pending_start_ = std::chrono::high_resolution_clock::now();
+
+		return this->transport_->send(data);
+	}
+
+	bool client::read_frame(std::string* frame)
+	{
+		while (this->receive_buffer_.size() >= sizeof(int))
+		{
+			int size;
+			std::memcpy(&size, this->receive_buffer_.data(), sizeof(size));
+
+			// Answers to empty frames carry nothing
+			if (size <= 0)
+			{
+				this->receive_buffer_.erase(0, sizeof(size));
+				continue;
+			}
+
+			if (this->receive_buffer_.size() - sizeof(size) < size_t(size)) return false;
+
+			frame->assign(this->receive_buffer_, 0, sizeof(size) + size);
+			this->receive_buffer_.erase(0, sizeof(size) + size);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool client::handle_frame(const std::string& frame, std::vector<completion>* completions)
+	{
+		byte_view buffer(frame);
+		buffer.set_use_data_types(false);
+
+		int size;
+		bool encrypted;
+		if (!buffer.read_int32(&size) || !buffer.read_bool(&encrypted)) return false;
+
+		if (!encrypted)
+		{
+			uint8_t type{};
+			buffer.read_byte(&type);
+
+			// Connection id
+			if (this->state_ == state::handshake && type == 4)
+			{
+				return this->send_hello();
+			}
+
+			return true;
+		}
+
+		int seed;
+		if (!buffer.read_int32(&seed)) return false;
+
+		const auto remaining = buffer.get_remaining();
+		std::string decrypted(remaining.size(), '\0');
+		this->crypto_.decrypt(seed, reinterpret_cast<const uint8_t*>(remaining.data()),
+		                      reinterpret_cast<uint8_t*>(decrypted.data()), remaining.size());
+
+		byte_view reply(decrypted);
+		reply.set_use_data_types(false);
+
+		int checksum;
+		uint8_t message_type;
+		if (!reply.read_int32(&checksum) || !reply.read_byte(&message_type)) return false;
+
+		reply.set_use_data_types(true);
+
+		uint64_t transaction_id;
+		uint32_t error;
+		if (message_type != 1 || !reply.read_uint64(&transaction_id) || !reply.read_uint32(&error))
+		{
+			return false;
+		}
+
+		if (this->state_ != state::waiting) return false;
+
+		if (this->pending_recorded_)
+		{
+			completions->push_back({
+				this->pending_kind_, error,
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::high_resolution_clock::now() - this->pending_start_)
+			});
+		}
+
+		this->state_ = state::idle;
+		return true;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "transport.hpp"
+#include "game/demonware/crypto_session.hpp"
+
+namespace demonware
+{
+	enum class request_kind
+	{
+		server_time,
+		user_raw_data,
+		publisher_file,
+		list_publisher_files,
+		get_user_file,
+		set_user_file,
+	};
+
+	struct request_info
+	{
+		request_kind kind;
+		const char* name;
+		uint8_t type;
+		uint8_t sub_type;
+	};
+
+	const std::vector<request_info>& get_request_infos();
+	const request_info& get_request_info(request_kind kind);
+
+	// A simulated game client: connection id handshake, bdLSGHello,
+	// then one encrypted service call after the other
+	class client final
+	{
+	public:
+		struct completion
+		{
+			request_kind kind;
+			uint32_t error;
+			std::chrono::microseconds latency;
+		};
+
+		client(std::unique_ptr<transport> transport, uint64_t id);
+
+		// Handles received replies and sends the next request once the previous one completed.
+		// Returns false if the connection was lost.
+		bool update(const std::function<request_kind()>& next_request, std::vector<completion>* completions);
+
+		uint64_t get_id() const;
+		transport& get_transport() const;
+
+	private:
+		enum class state
+		{
+			connecting,
+			handshake,
+			idle,
+			waiting,
+		};
+
+		std::unique_ptr<transport> transport_;
+		uint64_t id_;
+
+		state state_ = state::connecting;
+		bool seeded_ = false;
+		uint32_t writes_ = 0;
+		crypto_session crypto_;
+		std::string receive_buffer_;
+
+		request_kind pending_kind_{};
+		bool pending_recorded_ = false;
+		std::chrono::high_resolution_clock::time_point pending_start_{};
+
+		std::string get_user_filename() const;
+
+		bool send_hello();
+		bool send_request(request_kind kind, bool recorded);
+
+		bool read_frame(std::string* frame);
+		bool handle_frame(const std::string& frame, std::vector<completion>* completions);
+	};
+}
@@ -0,0 +1,135 @@
+#include <std_include.hpp>
+#include "crypto_benchmark.hpp"
+#include "game/demonware/i_server.hpp"
+#include "utils/cryptography.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		const uint8_t key[24]
+		{
+			0x13, 0x37, 0x13, 0x37, 0x13, 0x37, 0x13, 0x37,
+			0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42,
+			0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+		};
+
+		// encrypted_reply::get_data as it was
+		std::string encrypt_reply(const uint8_t type, const std::string& payload)
+		{
+			byte_buffer result;
+			result.set_use_data_types(false);
+
+			byte_buffer enc_buffer;
+			enc_buffer.set_use_data_types(false);
+			enc_buffer.write_int32(0xDEADBEEF);
+			enc_buffer.write_byte(type);
+			enc_buffer.write(payload);
+
+			auto data = enc_buffer.get_buffer();
+
+			auto size = enc_buffer.size();
+			size = ~7 & (size + 7); // 8 byte align
+			data.resize(size);
+
+			result.write_int32(static_cast<int>(size) + 5);
+			result.write_byte(true);
+
+			auto seed = crypto_session::reply_seed;
+			result.write_int32(seed);
+
+			const auto iv = utils::cryptography::tiger::compute(std::string(reinterpret_cast<char*>(&seed), 4));
+			result.write(utils::cryptography::des3::encrypt(data, iv, std::string(reinterpret_cast<const char*>(key),
+			                                                                     sizeof(key))));
+
+			return result.get_buffer();
+		}
+
+		// The request side as it was: hash the seed, copy the payload out, then decrypt into a new string
+		std::string decrypt_request(const int seed, const std::string& data)
+		{
+			const auto iv = utils::cryptography::tiger::compute(std::string(reinterpret_cast<const char*>(&seed), 4));
+			return utils::cryptography::des3::decrypt(data, iv, std::string(reinterpret_cast<const char*>(key),
+			                                                                 sizeof(key)));
+		}
+
+		template <typename F>
+		double measure(const size_t size, const std::chrono::seconds duration, F&& callback)
+		{
+			uint64_t bytes = 0;
+			const auto start = std::chrono::high_resolution_clock::now();
+			auto now = start;
+
+			while (now - start < duration)
+			{
+				callback();
+				bytes += size;
+
+				now = std::chrono::high_resolution_clock::now();
+			}
+
+			const std::chrono::duration<double> elapsed = now - start;
+			return static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed.count();
+		}
+
+		void print(const char* name, const double old_throughput, const double throughput)
+		{
+			printf("%24s %12.1f %12.1f %7.1fx\n", name, old_throughput, throughput,
+			       old_throughput > 0 ? throughput / old_throughput : 0.0);
+		}
+	}
+
+	void run_crypto_benchmark(const std::chrono::seconds duration)
+	{
+		crypto_session crypto;
+		crypto.set_key(true, key);
+		crypto.set_key(false, key);
+
+		printf("3DES throughput, %zus per run\n", static_cast<size_t>(duration.count()));
+		printf("%24s %12s %12s %8s\n", "message", "old MB/s", "new MB/s", "speedup");
+
+		for (const auto size : {size_t(64), size_t(1024), size_t(64 * 1024)})
+		{
+			const std::string payload(size, 'x');
+
+			// Both have to produce the same frame before their speed means anything
+			byte_buffer buffer(payload);
+			if (encrypted_reply(1, &buffer, crypto).get_data() != encrypt_reply(1, payload))
+			{
+				printf("Encrypted replies of %zu bytes differ\n", size);
+				return;
+			}
+
+			const auto old_encrypt = measure(size, duration, [&payload]()
+			{
+				encrypt_reply(1, payload);
+			});
+
+			const auto encrypt = measure(size, duration, [&payload, &crypto]()
+			{
+				byte_buffer data(payload);
+				encrypted_reply(1, &data, crypto).get_data();
+			});
+
+			const auto name = std::to_string(size) + " byte reply";
+			print(name.data(), old_encrypt, encrypt);
+
+			const auto seed = 0x12345678;
+			std::string output(payload.size(), '\0');
+
+			const auto old_decrypt = measure(size, duration, [&payload, seed]()
+			{
+				decrypt_request(seed, payload);
+			});
+
+			const auto decrypt = measure(size, duration, [&payload, &output, &crypto, seed]()
+			{
+				crypto.decrypt(seed, reinterpret_cast<const uint8_t*>(payload.data()),
+				               reinterpret_cast<uint8_t*>(output.data()), payload.size());
+			});
+
+			const auto request_name = std::to_string(size) + " byte request";
+			print(request_name.data(), old_decrypt, decrypt);
+		}
+	}
+}
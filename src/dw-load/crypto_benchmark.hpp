@@ -0,0 +1,8 @@
+#pragma once
+
+namespace demonware
+{
+	// Encrypting replies and decrypting requests with a fresh 3DES key schedule
+	// and IV hash per message, as it used to be, against a crypto_session
+	void run_crypto_benchmark(std::chrono::seconds duration);
+}
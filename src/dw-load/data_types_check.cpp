@@ -0,0 +1,287 @@
+#include <std_include.hpp>
+#include "data_types_check.hpp"
+#include "game/demonware/data_types.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr size_t iterations = 2000;
+
+		class random_values
+		{
+		public:
+			explicit random_values(const uint32_t seed) : generator_(seed)
+			{
+			}
+
+			template <typename T>
+			T integer()
+			{
+				std::uniform_int_distribution<uint64_t> distribution;
+				return static_cast<T>(distribution(this->generator_));
+			}
+
+			float real()
+			{
+				std::uniform_real_distribution<float> distribution(-180.0f, 180.0f);
+				return distribution(this->generator_);
+			}
+
+			// Strings end at the first null on the wire, blobs carry anything
+			std::string string(const size_t max_length)
+			{
+				std::uniform_int_distribution<size_t> length(0, max_length);
+				std::uniform_int_distribution<int> character(1, 255);
+
+				std::string result(length(this->generator_), '\0');
+				for (auto& c : result) c = static_cast<char>(character(this->generator_));
+				return result;
+			}
+
+			std::string blob(const size_t max_length)
+			{
+				std::uniform_int_distribution<size_t> length(0, max_length);
+				std::uniform_int_distribution<int> character(0, 255);
+
+				std::string result(length(this->generator_), '\0');
+				for (auto& c : result) c = static_cast<char>(character(this->generator_));
+				return result;
+			}
+
+		private:
+			std::mt19937 generator_;
+		};
+
+		void fill(bdFileData& data, random_values& random)
+		{
+			data.file_data = random.blob(512);
+		}
+
+		void write_reference(bdFileData& data, byte_buffer* buffer)
+		{
+			buffer->write_blob(data.file_data);
+		}
+
+		void fill(bdFileInfo& info, random_values& random)
+		{
+			info.file_id = random.integer<uint64_t>();
+			info.create_time = random.integer<uint32_t>();
+			info.modified_time = random.integer<uint32_t>();
+			info.priv = random.integer<bool>();
+			info.owner_id = random.integer<uint64_t>();
+			info.filename = random.string(64);
+			info.file_size = random.integer<uint32_t>();
+		}
+
+		void write_reference(bdFileInfo& info, byte_buffer* buffer)
+		{
+			buffer->write_uint32(info.file_size);
+			buffer->write_uint64(info.file_id);
+			buffer->write_uint32(info.create_time);
+			buffer->write_uint32(info.modified_time);
+			buffer->write_bool(info.priv);
+			buffer->write_uint64(info.owner_id);
+			buffer->write_string(info.filename);
+		}
+
+		void fill(bdGroupCount& count, random_values& random)
+		{
+			count.group_id = random.integer<uint32_t>();
+			count.group_count = random.integer<uint32_t>();
+		}
+
+		void write_reference(bdGroupCount& count, byte_buffer* buffer)
+		{
+			buffer->write_uint32(count.group_id);
+			buffer->write_uint32(count.group_count);
+		}
+
+		void fill(bdTimeStamp& time, random_values& random)
+		{
+			time.unix_time = random.integer<uint32_t>();
+		}
+
+		void write_reference(bdTimeStamp& time, byte_buffer* buffer)
+		{
+			buffer->write_uint32(time.unix_time);
+		}
+
+		void fill(bdDMLInfo& info, random_values& random)
+		{
+			info.country_code = random.string(2);
+			info.country = random.string(64);
+			info.region = random.string(64);
+			info.city = random.string(128);
+			info.latitude = random.real();
+			info.longitude = random.real();
+		}
+
+		void write_reference(bdDMLInfo& info, byte_buffer* buffer)
+		{
+			buffer->write_string(info.country_code);
+			buffer->write_string(info.country);
+			buffer->write_string(info.region);
+			buffer->write_string(info.city);
+			buffer->write_float(info.latitude);
+			buffer->write_float(info.longitude);
+		}
+
+		void fill(bdDMLRawData& data, random_values& random)
+		{
+			fill(static_cast<bdDMLInfo&>(data), random);
+			data.asn = random.integer<uint32_t>();
+			data.timezone = random.string(32);
+		}
+
+		void write_reference(bdDMLRawData& data, byte_buffer* buffer)
+		{
+			write_reference(static_cast<bdDMLInfo&>(data), buffer);
+			buffer->write_uint32(data.asn);
+			buffer->write_string(data.timezone);
+		}
+
+		void fill(MatchMakingInfo& info, random_values& random)
+		{
+			info.session_id.session_id = random.integer<uint64_t>();
+			info.host_addr = random.blob(64);
+			info.game_type = random.integer<uint32_t>();
+			info.max_players = random.integer<uint32_t>();
+			info.num_players = random.integer<uint32_t>();
+
+			info.playlist_number = random.integer<int32_t>();
+			info.playlist_version = random.integer<int32_t>();
+			info.netcode_version = random.integer<int32_t>();
+			info.map_packs = random.integer<int32_t>();
+			info.slots_needed_on_team = random.integer<int32_t>();
+			info.skill = random.integer<int32_t>();
+			info.country_code = random.integer<uint32_t>();
+			info.asn = random.integer<uint32_t>();
+			info.latitude = random.real();
+			info.longitude = random.real();
+			info.max_reserved_slots = random.integer<int32_t>();
+			info.used_reserved_slots = random.integer<int32_t>();
+			info.game_security_key = random.blob(16);
+			info.platform_session_id = random.blob(16);
+			info.data_centres = random.integer<uint32_t>();
+			info.coop_state = random.integer<uint32_t>();
+		}
+
+		void write_reference(MatchMakingInfo& info, byte_buffer* buffer)
+		{
+			info.bdMatchmakingInfo::serialize(buffer);
+
+			buffer->write_int32(info.playlist_number);
+			buffer->write_int32(info.playlist_version);
+			buffer->write_int32(info.netcode_version);
+			buffer->write_int32(info.map_packs);
+			buffer->write_int32(info.slots_needed_on_team);
+			buffer->write_int32(info.skill);
+			buffer->write_uint32(info.country_code);
+			buffer->write_uint32(info.asn);
+			buffer->write_float(info.latitude);
+			buffer->write_float(info.longitude);
+			buffer->write_int32(info.max_reserved_slots);
+			buffer->write_int32(info.used_reserved_slots);
+			buffer->write_blob(info.game_security_key);
+			buffer->write_blob(info.platform_session_id);
+			buffer->write_uint32(info.data_centres);
+			buffer->write_uint32(info.coop_state);
+		}
+
+		void fill(bdPerformanceValue& value, random_values& random)
+		{
+			value.user_id = random.integer<uint64_t>();
+			value.performance = random.integer<int64_t>();
+		}
+
+		void write_reference(bdPerformanceValue& value, byte_buffer* buffer)
+		{
+			buffer->write_uint64(value.user_id);
+			buffer->write_int64(value.performance);
+		}
+
+		template <typename T>
+		std::unique_ptr<T> create()
+		{
+			std::unique_ptr<T> object;
+			if constexpr (std::is_default_constructible_v<T>) object = std::make_unique<T>();
+			else object = std::make_unique<T>(std::string{});
+
+			// Matchmaking info is only read back completely when it is symmetric
+			if constexpr (std::is_base_of_v<bdMatchmakingInfo, T>) object->symmetric = true;
+			return object;
+		}
+
+		std::string serialize(i_serializable& object, const bool data_types)
+		{
+			byte_buffer buffer;
+			buffer.set_use_data_types(data_types);
+			object.serialize(&buffer);
+			return std::move(buffer.get_buffer());
+		}
+
+		template <typename T>
+		bool check_type(const char* name, random_values& random)
+		{
+			for (size_t i = 0; i < iterations; ++i)
+			{
+				const auto object = create<T>();
+				fill(*object, random);
+
+				for (const auto data_types : {true, false})
+				{
+					byte_buffer reference;
+					reference.set_use_data_types(data_types);
+					write_reference(*object, &reference);
+
+					const auto data = serialize(*object, data_types);
+					if (data != reference.get_buffer())
+					{
+						printf("%s: layout differs from the reference, %zu bytes instead of %zu\n", name, data.size(),
+						       reference.get_buffer().size());
+						return false;
+					}
+
+					if (schema::size(*object, data_types) != data.size())
+					{
+						printf("%s: computed size %zu, wrote %zu bytes\n", name, schema::size(*object, data_types),
+						       data.size());
+						return false;
+					}
+
+					byte_buffer input(data);
+					input.set_use_data_types(data_types);
+
+					const auto copy = create<T>();
+					copy->deserialize(&input);
+
+					if (input.has_more_data() || serialize(*copy, data_types) != data)
+					{
+						printf("%s: round trip changed the object\n", name);
+						return false;
+					}
+				}
+			}
+
+			return true;
+		}
+	}
+
+	bool run_data_types_check()
+	{
+		random_values random(1337);
+
+		auto passed = true;
+		passed &= check_type<bdFileData>("bdFileData", random);
+		passed &= check_type<bdFileInfo>("bdFileInfo", random);
+		passed &= check_type<bdGroupCount>("bdGroupCount", random);
+		passed &= check_type<bdTimeStamp>("bdTimeStamp", random);
+		passed &= check_type<bdDMLInfo>("bdDMLInfo", random);
+		passed &= check_type<bdDMLRawData>("bdDMLRawData", random);
+		passed &= check_type<MatchMakingInfo>("MatchMakingInfo", random);
+		passed &= check_type<bdPerformanceValue>("bdPerformanceValue", random);
+
+		return passed;
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace demonware
+{
+	// Serializes every described data type with random contents and compares the bytes
+	// to the hand-written layout the types had before, then reads them back.
+	bool run_data_types_check();
+}
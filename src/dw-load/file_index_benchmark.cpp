@@ -0,0 +1,252 @@
+#include <std_include.hpp>
+#include "file_index_benchmark.hpp"
+#include "game/demonware/file_index.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr size_t benchmark_file_count = 100000;
+		constexpr size_t check_file_count = 2000;
+		constexpr size_t check_queries = 2000;
+
+		// Most files belong to a few busy owners, legacy uploads have none
+		std::vector<std::pair<std::string, file_index::file_info>> generate_files(const size_t count,
+		                                                                          std::mt19937& generator)
+		{
+			constexpr const char* names[] = {"stats", "loadout", "playlist", "emblem", "mpdata"};
+
+			std::uniform_int_distribution<uint64_t> owner(0, 15);
+			std::uniform_int_distribution<uint32_t> time(0, 1000);
+			std::uniform_int_distribution<size_t> name(0, std::size(names) - 1);
+
+			std::vector<std::pair<std::string, file_index::file_info>> files;
+			files.reserve(count);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				file_index::file_info info{};
+				info.file_id = i;
+				info.filename = std::string(names[name(generator)]) + "_" + std::to_string(i % (count / 4 + 1)) + ".dat";
+				info.owner = owner(generator);
+				info.create_time = time(generator);
+				info.modified_time = info.create_time;
+				info.size = 1024;
+
+				files.emplace_back(std::to_string(i), std::move(info));
+			}
+
+			return files;
+		}
+
+		// What list has to return, worked out the slow way
+		std::vector<uint64_t> list_by_hand(const std::vector<std::pair<std::string, file_index::file_info>>& files,
+		                                   const file_index::query& query)
+		{
+			std::vector<const std::pair<std::string, file_index::file_info>*> matches;
+			for (const auto& file : files)
+			{
+				const auto& info = file.second;
+				if (info.owner != query.owner && !(query.include_unowned && info.owner == 0)) continue;
+				if (!info.filename.starts_with(query.prefix)) continue;
+				if (query.pattern && !std::regex_match(info.filename, *query.pattern)) continue;
+				if (info.modified_time < query.min_modified_time) continue;
+
+				matches.push_back(&file);
+			}
+
+			std::sort(matches.begin(), matches.end(), [](const auto* a, const auto* b)
+			{
+				if (a->second.filename != b->second.filename) return a->second.filename < b->second.filename;
+				return a->first < b->first;
+			});
+
+			std::vector<uint64_t> result;
+			const auto limit = query.num_results ? query.num_results : SIZE_MAX;
+
+			for (auto i = query.offset; i < matches.size() && result.size() < limit; ++i)
+			{
+				result.push_back(matches[i]->second.file_id);
+			}
+
+			return result;
+		}
+
+		std::vector<uint64_t> get_ids(const std::vector<file_index::file_info>& files)
+		{
+			std::vector<uint64_t> ids;
+			for (const auto& file : files)
+			{
+				ids.push_back(file.file_id);
+			}
+
+			return ids;
+		}
+
+		file_index::query generate_query(std::mt19937& generator, const std::regex& pattern)
+		{
+			constexpr const char* prefixes[] = {"", "s", "stats", "stats_1", "loadout_", "mpdata_42", "zzz"};
+
+			std::uniform_int_distribution<uint64_t> owner(0, 15);
+			std::uniform_int_distribution<size_t> prefix(0, std::size(prefixes) - 1);
+			std::uniform_int_distribution<uint32_t> time(0, 1000);
+			std::uniform_int_distribution<size_t> offset(0, 200);
+			std::uniform_int_distribution<size_t> num_results(0, 50);
+			std::uniform_int_distribution<int> coin(0, 3);
+
+			file_index::query query{};
+			query.owner = owner(generator);
+			query.include_unowned = coin(generator) != 0;
+			query.prefix = prefixes[prefix(generator)];
+			query.pattern = coin(generator) == 0 ? &pattern : nullptr;
+			query.min_modified_time = coin(generator) == 0 ? time(generator) : 0;
+			query.offset = offset(generator);
+			query.num_results = num_results(generator);
+
+			return query;
+		}
+
+		template <typename F>
+		void measure(const char* name, const std::chrono::nanoseconds duration, F&& callback)
+		{
+			std::vector<double> samples;
+			const auto end = std::chrono::high_resolution_clock::now() + duration;
+
+			while (std::chrono::high_resolution_clock::now() < end)
+			{
+				const auto start = std::chrono::high_resolution_clock::now();
+				callback();
+
+				const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+				samples.push_back(elapsed.count());
+			}
+
+			std::sort(samples.begin(), samples.end());
+
+			const auto percentile = [&samples](const double value)
+			{
+				return samples[std::min(static_cast<size_t>(value * samples.size()), samples.size() - 1)];
+			};
+
+			printf("%28s %10zu %12.1f %12.1f\n", name, samples.size(), percentile(0.5), percentile(0.99));
+		}
+
+		double time_once(const std::function<void()>& callback)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			callback();
+
+			const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			return elapsed.count();
+		}
+	}
+
+	bool run_file_index_check()
+	{
+		std::mt19937 generator(1337);
+		const std::regex pattern(".*_1[0-9]*\\.dat");
+
+		auto files = generate_files(check_file_count, generator);
+
+		// Built both ways: file by file like user_storage::write, and in one go like loading the index
+		file_index updated;
+		for (const auto& file : files)
+		{
+			updated.update(file.first, file.second);
+		}
+
+		file_index loaded;
+		if (!loaded.deserialize(updated.serialize()) || loaded.size() != files.size())
+		{
+			printf("Index did not survive serialization\n");
+			return false;
+		}
+
+		for (size_t i = 0; i < check_queries; ++i)
+		{
+			const auto query = generate_query(generator, pattern);
+			const auto expected = list_by_hand(files, query);
+
+			if (get_ids(updated.list(query)) != expected || get_ids(loaded.list(query)) != expected)
+			{
+				printf("Query %zu (owner %llu, prefix '%s', offset %zu) returned the wrong page\n", i,
+				       query.owner, query.prefix.data(), query.offset);
+				return false;
+			}
+		}
+
+		printf("%zu random queries match a full scan\n", check_queries);
+		return true;
+	}
+
+	void run_file_index_benchmark(const std::chrono::seconds duration)
+	{
+		std::mt19937 generator(1337);
+		const auto files = generate_files(benchmark_file_count, generator);
+
+		printf("File index with %zu files\n", benchmark_file_count);
+
+		file_index index;
+		printf("%28s %9.1f ms\n", "update file by file", time_once([&]()
+		{
+			for (const auto& file : files)
+			{
+				index.update(file.first, file.second);
+			}
+		}));
+
+		std::string data;
+		printf("%28s %9.1f ms\n", "serialize", time_once([&]()
+		{
+			data = index.serialize();
+		}));
+
+		file_index loaded;
+		printf("%28s %9.1f ms\n", "deserialize", time_once([&]()
+		{
+			loaded.deserialize(data);
+		}));
+
+		printf("\n%28s %10s %12s %12s\n", "listing", "queries", "p50 us", "p99 us");
+
+		const auto per_query = std::chrono::duration_cast<std::chrono::nanoseconds>(duration) / 5;
+		std::uniform_int_distribution<size_t> offset(0, benchmark_file_count / 16);
+
+		file_index::query query{};
+		query.owner = 1;
+		query.include_unowned = true;
+		query.num_results = 10;
+
+		measure("first page", per_query, [&]()
+		{
+			loaded.list(query);
+		});
+
+		measure("random page, merged owners", per_query, [&]()
+		{
+			query.offset = offset(generator);
+			loaded.list(query);
+		});
+
+		query.include_unowned = false;
+		measure("random page, one owner", per_query, [&]()
+		{
+			query.offset = offset(generator);
+			loaded.list(query);
+		});
+
+		query.offset = 0;
+		query.prefix = "stats_1";
+		measure("prefix", per_query, [&]()
+		{
+			loaded.list(query);
+		});
+
+		const std::regex pattern("stats_1[0-9]*7\\.dat");
+		query.pattern = &pattern;
+		measure("prefix and pattern", per_query, [&]()
+		{
+			loaded.list(query);
+		});
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace demonware
+{
+	// Compares paginated listings against filtering every file by hand
+	bool run_file_index_check();
+
+	// Loads and lists an index of 100k user files
+	void run_file_index_benchmark(std::chrono::seconds duration);
+}
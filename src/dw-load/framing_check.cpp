@@ -0,0 +1,221 @@
+#include <std_include.hpp>
+#include "framing_check.hpp"
+#include "client.hpp"
+#include "game/demonware/core.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr size_t recorded_requests = 64;
+		constexpr size_t replay_count = 32;
+		constexpr auto reply_timeout = 5s;
+
+		// Keeps a copy of everything going over the wrapped transport
+		class recording_transport final : public transport
+		{
+		public:
+			explicit recording_transport(std::unique_ptr<transport> transport) : transport_(std::move(transport))
+			{
+			}
+
+			bool send(const std::string& data) override
+			{
+				this->sent_.append(data);
+				return this->transport_->send(data);
+			}
+
+			bool receive(std::string* buffer) override
+			{
+				const auto offset = buffer->size();
+				if (!this->transport_->receive(buffer)) return false;
+
+				this->received_.append(*buffer, offset);
+				return true;
+			}
+
+			const std::string& get_sent() const
+			{
+				return this->sent_;
+			}
+
+			const std::string& get_received() const
+			{
+				return this->received_;
+			}
+
+		private:
+			std::unique_ptr<transport> transport_;
+			std::string sent_;
+			std::string received_;
+		};
+
+		// Frame sizes are all that stays the same between runs, the contents carry times and transaction ids
+		std::vector<int> get_frame_sizes(const std::string& data, size_t* consumed = nullptr)
+		{
+			std::vector<int> sizes;
+
+			size_t offset = 0;
+			while (data.size() - offset >= sizeof(int))
+			{
+				int size;
+				std::memcpy(&size, data.data() + offset, sizeof(size));
+
+				const auto length = size_t(std::max(size, 0));
+				if (data.size() - offset - sizeof(size) < length) break;
+
+				sizes.push_back(size);
+				offset += sizeof(size) + length;
+			}
+
+			if (consumed) *consumed = offset;
+			return sizes;
+		}
+
+		bool record(core& core, std::string* stream, std::vector<int>* replies)
+		{
+			const auto server = core.find_server_by_name("mw3-pc-lobby.prod.demonware.net");
+
+			auto transport = std::make_unique<recording_transport>(
+				std::make_unique<session_transport>(server->create_session()));
+			auto* recorder = transport.get();
+
+			client client(std::move(transport), 1);
+
+			size_t next = 0;
+			const auto& infos = get_request_infos();
+			const auto next_request = [&]()
+			{
+				return infos[next++ % infos.size()].kind;
+			};
+
+			std::vector<client::completion> completions;
+			const auto end = std::chrono::high_resolution_clock::now() + reply_timeout;
+
+			while (completions.size() < recorded_requests)
+			{
+				if (!client.update(next_request, &completions) || std::chrono::high_resolution_clock::now() > end)
+				{
+					return false;
+				}
+
+				std::this_thread::sleep_for(1ms);
+			}
+
+			// Everything but bdLSGHello is answered, including a request the last update might have sent
+			std::string buffer;
+			while (get_frame_sizes(recorder->get_received()).size() + 1 < get_frame_sizes(recorder->get_sent()).size())
+			{
+				if (!recorder->receive(&buffer) || std::chrono::high_resolution_clock::now() > end)
+				{
+					return false;
+				}
+
+				std::this_thread::sleep_for(1ms);
+			}
+
+			*stream = recorder->get_sent();
+			*replies = get_frame_sizes(recorder->get_received());
+			return true;
+		}
+
+		std::vector<int> replay(core& core, const std::string& stream, const std::vector<size_t>& cuts,
+		                        const size_t expected)
+		{
+			const auto server = core.find_server_by_name("mw3-pc-lobby.prod.demonware.net");
+			session_transport transport(server->create_session());
+
+			size_t start = 0;
+			for (const auto cut : cuts)
+			{
+				transport.send(stream.substr(start, cut - start));
+				start = cut;
+			}
+
+			std::string received;
+			std::vector<int> replies;
+			const auto end = std::chrono::high_resolution_clock::now() + reply_timeout;
+
+			while (replies.size() < expected && std::chrono::high_resolution_clock::now() < end)
+			{
+				std::this_thread::sleep_for(1ms);
+
+				transport.receive(&received);
+				replies = get_frame_sizes(received);
+			}
+
+			return replies;
+		}
+
+		bool compare(const char* name, const std::vector<int>& expected, const std::vector<int>& replies)
+		{
+			if (replies == expected) return true;
+
+			printf("%s: got %zu replies, expected %zu\n", name, replies.size(), expected.size());
+			return false;
+		}
+	}
+
+	bool run_framing_check()
+	{
+		core::settings settings{};
+		settings.worker_count = 2;
+		settings.storage_directory = "dw-load/framing";
+
+		core core(settings);
+		core.register_default_servers();
+
+		std::string stream;
+		std::vector<int> expected;
+		if (!record(core, &stream, &expected))
+		{
+			printf("Failed to record a client session\n");
+			return false;
+		}
+
+		size_t consumed;
+		const auto frames = get_frame_sizes(stream, &consumed);
+		if (consumed != stream.size())
+		{
+			printf("Recorded stream ends in a partial frame\n");
+			return false;
+		}
+
+		// Every frame in its own send, the way the client sent them
+		std::vector<size_t> cuts;
+		size_t offset = 0;
+		for (const auto size : frames)
+		{
+			offset += sizeof(size) + size_t(std::max(size, 0));
+			cuts.push_back(offset);
+		}
+
+		auto passed = compare("whole frames", expected, replay(core, stream, cuts, expected.size()));
+		passed &= compare("one send", expected, replay(core, stream, {stream.size()}, expected.size()));
+
+		// Cuts anywhere, so sends end inside the size, inside the body, or span several frames
+		std::mt19937 generator(1337);
+		for (size_t i = 0; i < replay_count; ++i)
+		{
+			std::uniform_int_distribution<size_t> count(1, frames.size() * 2);
+			std::uniform_int_distribution<size_t> position(1, stream.size() - 1);
+
+			cuts.resize(count(generator));
+			for (auto& cut : cuts)
+			{
+				cut = position(generator);
+			}
+
+			cuts.push_back(stream.size());
+			std::sort(cuts.begin(), cuts.end());
+			cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+			const auto name = "random split " + std::to_string(i);
+			passed &= compare(name.data(), expected, replay(core, stream, cuts, expected.size()));
+		}
+
+		printf("Replayed %zu frames (%zu bytes) in %zu ways: %s\n", frames.size(), stream.size(), replay_count + 2,
+		       passed ? "passed" : "FAILED");
+		return passed;
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace demonware
+{
+	// Records a client session, then replays its byte stream split and
+	// coalesced at random boundaries. Every replay has to produce the same replies.
+	bool run_framing_check();
+}
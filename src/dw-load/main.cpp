@@ -0,0 +1,512 @@
+#include <std_include.hpp>
+#include "allocation_benchmark.hpp"
+#include "bit_buffer_benchmark.hpp"
+#include "client.hpp"
+#include "crypto_benchmark.hpp"
+#include "data_types_check.hpp"
+#include "file_index_benchmark.hpp"
+#include "framing_check.hpp"
+#include "queue_benchmark.hpp"
+#include "reply_benchmark.hpp"
+#include "report.hpp"
+#include "socket_benchmark.hpp"
+#include "storage_benchmark.hpp"
+#include "game/demonware/core.hpp"
+
+namespace
+{
+	using namespace demonware;
+
+	struct options
+	{
+		size_t clients = 64;
+		size_t threads = 4;
+		std::chrono::seconds duration = 10s;
+		std::chrono::seconds warmup = 1s;
+
+		// Without a host the emulator runs in this process
+		std::string host;
+		uint16_t port = 3074;
+
+		std::string output = "dw-load.json";
+
+		// Runs a micro benchmark or self-checks instead of simulating clients
+		std::string benchmark;
+		std::string check;
+		std::vector<std::pair<request_kind, uint32_t>> mix;
+		core::settings settings;
+
+		// Added to every storage read and write of the in-process emulator
+		int io_latency = 0;
+	};
+
+	// Wakes a driver when a session of the in-process core queued a reply
+	class waker final
+	{
+	public:
+		void notify()
+		{
+			{
+				std::lock_guard _(this->mutex_);
+				this->pending_ = true;
+			}
+
+			this->signal_.notify_one();
+		}
+
+		void wait(const std::chrono::milliseconds timeout)
+		{
+			std::unique_lock lock(this->mutex_);
+			this->signal_.wait_for(lock, timeout, [this]()
+			{
+				return this->pending_;
+			});
+
+			this->pending_ = false;
+		}
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable signal_;
+		bool pending_ = false;
+	};
+
+	// Runs a share of the clients on its own thread, each with one request in flight
+	class driver final
+	{
+	public:
+		driver(const options& options, const size_t index) : options_(&options),
+		                                                      generator_(static_cast<uint32_t>(index))
+		{
+			std::vector<double> weights;
+			for (const auto& entry : options.mix)
+			{
+				this->kinds_.push_back(entry.first);
+				weights.push_back(entry.second);
+			}
+
+			this->distribution_ = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+		}
+
+		void add_client(std::unique_ptr<client> client)
+		{
+			if (this->options_->host.empty())
+			{
+				// Replies are pushed by the core's workers
+				auto& transport = static_cast<session_transport&>(client->get_transport());
+				transport.get_session()->set_reply_handler([waker = this->waker_]()
+				{
+					waker->notify();
+				});
+			}
+
+			this->clients_.push_back(std::move(client));
+		}
+
+		void start(const std::chrono::high_resolution_clock::time_point measure_start,
+		           const std::chrono::high_resolution_clock::time_point end)
+		{
+			this->thread_ = std::thread([this, measure_start, end]()
+			{
+				this->run(measure_start, end);
+			});
+		}
+
+		void join()
+		{
+			if (this->thread_.joinable())
+			{
+				this->thread_.join();
+			}
+		}
+
+		report& get_report()
+		{
+			return this->report_;
+		}
+
+		size_t get_disconnects() const
+		{
+			return this->disconnects_;
+		}
+
+	private:
+		const options* options_;
+		std::thread thread_;
+
+		std::mt19937 generator_;
+		std::vector<request_kind> kinds_;
+		std::discrete_distribution<size_t> distribution_;
+
+		std::shared_ptr<waker> waker_ = std::make_shared<waker>();
+		std::vector<std::unique_ptr<client>> clients_;
+
+		report report_;
+		size_t disconnects_ = 0;
+
+		void run(const std::chrono::high_resolution_clock::time_point measure_start,
+		         const std::chrono::high_resolution_clock::time_point end)
+		{
+			const auto next_request = [this]()
+			{
+				return this->kinds_[this->distribution_(this->generator_)];
+			};
+
+			std::vector<client::completion> completions;
+			std::vector<WSAPOLLFD> descriptors;
+
+			while (std::chrono::high_resolution_clock::now() < end && !this->clients_.empty())
+			{
+				for (auto i = this->clients_.begin(); i != this->clients_.end();)
+				{
+					if ((*i)->update(next_request, &completions))
+					{
+						++i;
+						continue;
+					}
+
+					++this->disconnects_;
+					i = this->clients_.erase(i);
+				}
+
+				// Requests completing during the warmup only fill the caches
+				if (std::chrono::high_resolution_clock::now() >= measure_start)
+				{
+					for (const auto& completion : completions)
+					{
+						this->report_.add(completion);
+					}
+				}
+
+				completions.clear();
+				this->wait(&descriptors);
+			}
+		}
+
+		void wait(std::vector<WSAPOLLFD>* descriptors) const
+		{
+			if (this->options_->host.empty())
+			{
+				this->waker_->wait(1ms);
+				return;
+			}
+
+			descriptors->clear();
+			for (const auto& client : this->clients_)
+			{
+				const auto& transport = static_cast<socket_transport&>(client->get_transport());
+				descriptors->push_back({transport.get_socket(), POLLRDNORM, 0});
+			}
+
+			if (!descriptors->empty())
+			{
+				WSAPoll(descriptors->data(), static_cast<ULONG>(descriptors->size()), 1);
+			}
+		}
+	};
+
+	std::optional<request_kind> find_request_kind(const std::string& name)
+	{
+		for (const auto& info : get_request_infos())
+		{
+			if (name == info.name) return info.kind;
+		}
+
+		return {};
+	}
+
+	// name:weight,name:weight,...
+	bool parse_mix(const std::string& value, std::vector<std::pair<request_kind, uint32_t>>* mix)
+	{
+		mix->clear();
+
+		size_t start = 0;
+		while (start < value.size())
+		{
+			auto next = value.find(',', start);
+			if (next == std::string::npos) next = value.size();
+
+			const auto entry = value.substr(start, next - start);
+			start = next + 1;
+
+			const auto separator = entry.find(':');
+			const auto kind = find_request_kind(entry.substr(0, separator));
+			if (!kind) return false;
+
+			const auto weight = separator == std::string::npos ? 1 : std::atoi(entry.data() + separator + 1);
+			if (weight > 0) mix->emplace_back(*kind, weight);
+		}
+
+		return !mix->empty();
+	}
+
+	bool parse_options(const int argc, char** argv, options* options)
+	{
+		options->settings.worker_count = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+		options->settings.storage_directory = "dw-load/user";
+
+		parse_mix("server_time:4,user_raw_data:2,publisher_file:2,list_publisher_files:1,get_user_file:2,set_user_file:1",
+		          &options->mix);
+
+		for (auto i = 1; i + 1 < argc; i += 2)
+		{
+			const std::string name = argv[i];
+			const std::string value = argv[i + 1];
+
+			if (name == "-clients") options->clients = std::max(1, std::atoi(value.data()));
+			else if (name == "-threads") options->threads = std::max(1, std::atoi(value.data()));
+			else if (name == "-duration") options->duration = std::chrono::seconds(std::max(1, std::atoi(value.data())));
+			else if (name == "-warmup") options->warmup = std::chrono::seconds(std::max(0, std::atoi(value.data())));
+			else if (name == "-host") options->host = value;
+			else if (name == "-port") options->port = static_cast<uint16_t>(std::atoi(value.data()));
+			else if (name == "-workers") options->settings.worker_count = std::max(1, std::atoi(value.data()));
+			else if (name == "-storage") options->settings.storage_directory = value;
+			else if (name == "-cache") options->settings.storage_cache_size = std::max(0, std::atoi(value.data()));
+			else if (name == "-io-latency") options->io_latency = std::max(0, std::atoi(value.data()));
+			else if (name == "-output") options->output = value;
+			else if (name == "-bench") options->benchmark = value;
+			else if (name == "-check") options->check = value;
+			else if (name == "-mix")
+			{
+				if (!parse_mix(value, &options->mix))
+				{
+					printf("Invalid request mix %s\n", value.data());
+					return false;
+				}
+			}
+			else
+			{
+				printf("Unknown option %s\n", name.data());
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::unique_ptr<transport> create_transport(const options& options, core* core)
+	{
+		if (options.host.empty())
+		{
+			const auto server = core->find_server_by_name("mw3-pc-lobby.prod.demonware.net");
+			return std::make_unique<session_transport>(server->create_session());
+		}
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(options.port);
+		if (inet_pton(AF_INET, options.host.data(), &address.sin_addr) != 1) return {};
+
+		return socket_transport::connect(address);
+	}
+
+	int run(const options& options)
+	{
+		std::unique_ptr<core> core;
+		if (options.host.empty())
+		{
+			core = std::make_unique<demonware::core>(options.settings);
+			core->register_default_servers();
+			core->set_io_latency(options.io_latency);
+		}
+
+		std::vector<std::unique_ptr<driver>> drivers;
+		for (size_t i = 0; i < std::min(options.threads, options.clients); ++i)
+		{
+			drivers.push_back(std::make_unique<driver>(options, i));
+		}
+
+		for (size_t i = 0; i < options.clients; ++i)
+		{
+			auto transport = create_transport(options, core.get());
+			if (!transport)
+			{
+				printf("Failed to connect client %zu\n", i);
+				return 1;
+			}
+
+			drivers[i % drivers.size()]->add_client(std::make_unique<client>(std::move(transport), i + 1));
+		}
+
+		const auto mode = options.host.empty() ? "in-process"s : "socket"s;
+		printf("Running %zu %s clients on %zu threads for %llds after %llds of warmup\n", options.clients, mode.data(),
+		       drivers.size(), options.duration.count(), options.warmup.count());
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		const auto measure_start = start + options.warmup;
+		const auto end = measure_start + options.duration;
+
+		for (const auto& driver : drivers)
+		{
+			driver->start(measure_start, end);
+		}
+
+		report report;
+		size_t disconnects = 0;
+
+		for (const auto& driver : drivers)
+		{
+			driver->join();
+			disconnects += driver->get_disconnects();
+			report.merge(std::move(driver->get_report()));
+		}
+
+		// Clients are gone before the core drains its workers
+		drivers.clear();
+		core.reset();
+
+		const std::chrono::duration<double> duration = options.duration;
+		report.print(duration);
+
+		if (disconnects)
+		{
+			printf("%zu clients lost their connection\n", disconnects);
+		}
+
+		if (!report.write_json(options.output, mode, options.clients, duration))
+		{
+			printf("Failed to write %s\n", options.output.data());
+			return 1;
+		}
+
+		printf("Results written to %s\n", options.output.data());
+		return disconnects ? 1 : 0;
+	}
+
+	// Unrelated calls have to stay fast while the disk holds up storage requests
+	void run_slow_disk_benchmark(const std::chrono::seconds duration)
+	{
+		for (const auto latency : {0, 50})
+		{
+			options options{};
+			parse_options(0, nullptr, &options);
+			parse_mix("server_time:2,get_user_file:4,set_user_file:4", &options.mix);
+
+			options.duration = duration;
+			options.io_latency = latency;
+			options.output = "dw-load-slow-disk-" + std::to_string(latency) + ".json";
+
+			// Far too small for the files of all clients, so most reads go to the disk
+			options.settings.storage_cache_size = 16 * 1024;
+			options.settings.storage_directory = "dw-load/slow-disk";
+
+			printf("\nStorage I/O latency %d ms\n", latency);
+			run(options);
+		}
+	}
+
+	struct benchmark
+	{
+		const char* name;
+		void (*run)(std::chrono::seconds duration);
+	};
+
+	const benchmark benchmarks[]
+	{
+		{"allocations", run_allocation_benchmark},
+		{"bit_buffer", run_bit_buffer_benchmark},
+		{"crypto", run_crypto_benchmark},
+		{"file_index", run_file_index_benchmark},
+		{"queue", run_queue_benchmark},
+		{"replies", run_reply_benchmark},
+		{"slow_disk", run_slow_disk_benchmark},
+		{"sockets", run_socket_benchmark},
+		{"storage", run_storage_benchmark},
+	};
+
+	struct check
+	{
+		const char* name;
+		bool (*run)();
+	};
+
+	const check checks[]
+	{
+		{"bit_buffer", run_bit_buffer_check},
+		{"data_types", run_data_types_check},
+		{"file_index", run_file_index_check},
+		{"framing", run_framing_check},
+	};
+
+	int run_checks(const std::string& name)
+	{
+		auto found = false;
+		auto failed = false;
+
+		for (const auto& check : checks)
+		{
+			if (name != "all" && name != check.name) continue;
+
+			found = true;
+			printf("Running %s check\n", check.name);
+
+			if (!check.run())
+			{
+				failed = true;
+			}
+		}
+
+		if (!found)
+		{
+			printf("Unknown check %s\n", name.data());
+			return 1;
+		}
+
+		return failed ? 1 : 0;
+	}
+}
+
+int main(const int argc, char** argv)
+{
+	options options{};
+	if (!parse_options(argc, argv, &options))
+	{
+		printf("Usage: dw-load [-clients n] [-threads n] [-duration s] [-warmup s] [-host ip] [-port n]\n"
+		       "               [-workers n] [-storage dir] [-cache bytes] [-io-latency ms]\n"
+		       "               [-mix name:weight,...] [-output file]\n"
+		       "       dw-load -bench allocations|bit_buffer|crypto|file_index|queue|replies|slow_disk|sockets|storage [-duration s]\n"
+		       "       dw-load -check all|bit_buffer|data_types|file_index|framing\n");
+		return 1;
+	}
+
+	WSADATA wsa_data;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa_data))
+	{
+		printf("Failed to initialize Winsock\n");
+		return 1;
+	}
+
+	const auto _ = gsl::finally([]()
+	{
+		WSACleanup();
+	});
+
+	try
+	{
+		if (!options.check.empty())
+		{
+			return run_checks(options.check);
+		}
+
+		if (!options.benchmark.empty())
+		{
+			for (const auto& benchmark : benchmarks)
+			{
+				if (options.benchmark != benchmark.name) continue;
+
+				benchmark.run(options.duration);
+				return 0;
+			}
+
+			printf("Unknown benchmark %s\n", options.benchmark.data());
+			return 1;
+		}
+
+		return run(options);
+	}
+	catch (std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,97 @@
+#include <std_include.hpp>
+#include "queue_benchmark.hpp"
+#include "game/demonware/service_server.hpp"
+#include "game/demonware/service_session.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		// What the game passes to recv
+		constexpr size_t receive_size = 0x10000;
+
+		// The outgoing queue as it was: one deque node per byte behind a recursive mutex
+		class char_queue final
+		{
+		public:
+			void send_reply(reply* data)
+			{
+				std::lock_guard _(this->mutex_);
+
+				const auto buffer = data->get_data();
+				for (const auto chr : buffer)
+				{
+					this->queue_.push(chr);
+				}
+			}
+
+			int recv(char* buf, const int len)
+			{
+				std::lock_guard _(this->mutex_);
+				if (this->queue_.empty()) return SOCKET_ERROR;
+
+				auto count = 0;
+				while (count < len && !this->queue_.empty())
+				{
+					buf[count++] = this->queue_.front();
+					this->queue_.pop();
+				}
+
+				return count;
+			}
+
+		private:
+			std::recursive_mutex mutex_;
+			std::queue<char> queue_;
+		};
+
+		template <typename Queue>
+		double measure(Queue& queue, const size_t reply_size, const std::chrono::seconds duration)
+		{
+			const std::string payload(reply_size, 'x');
+			std::vector<char> buffer(receive_size);
+
+			uint64_t bytes = 0;
+			const auto start = std::chrono::high_resolution_clock::now();
+			auto now = start;
+
+			while (now - start < duration)
+			{
+				raw_reply reply(payload);
+				queue.send_reply(&reply);
+
+				int received;
+				while ((received = queue.recv(buffer.data(), static_cast<int>(buffer.size()))) > 0)
+				{
+					bytes += received;
+				}
+
+				now = std::chrono::high_resolution_clock::now();
+			}
+
+			const std::chrono::duration<double> elapsed = now - start;
+			return static_cast<double>(bytes) / (1024.0 * 1024.0) / elapsed.count();
+		}
+	}
+
+	void run_queue_benchmark(const std::chrono::seconds duration)
+	{
+		const auto server = std::make_shared<service_server>("dw-load");
+
+		printf("send_reply -> recv throughput, %zu byte reads, %zus per run\n", receive_size,
+		       static_cast<size_t>(duration.count()));
+		printf("%10s %16s %16s %8s\n", "reply", "char MB/s", "chunked MB/s", "speedup");
+
+		for (const auto reply_size : {size_t(1024), size_t(64 * 1024), size_t(4 * 1024 * 1024)})
+		{
+			char_queue old_queue;
+			const auto old_throughput = measure(old_queue, reply_size, duration);
+
+			const auto session = server->create_session();
+			const auto throughput = measure(*session, reply_size, duration);
+
+			printf("%8zuKB %16.1f %16.1f %7.1fx\n", reply_size / 1024, old_throughput, throughput,
+			       old_throughput > 0 ? throughput / old_throughput : 0.0);
+		}
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace demonware
+{
+	// Throughput of replies going from send_reply to recv, the byte at a time
+	// queue the sessions used to have against the chunked byte_queue
+	void run_queue_benchmark(std::chrono::seconds duration);
+}
@@ -0,0 +1,123 @@
+#include <std_include.hpp>
+#include "reply_benchmark.hpp"
+#include "allocation_counter.hpp"
+#include "game/demonware/data_types.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		// Takes the frame like a session would and drops it
+		class null_server final : public i_server
+		{
+		public:
+			int send(const char*, int) override { return -1; }
+			int recv(char*, int) override { return -1; }
+
+			void send_reply(reply* reply) override
+			{
+				const auto data = reply->get_data();
+				this->bytes_ += data.size();
+			}
+
+			void defer(std::function<void()> work) override { work(); }
+			crypto_session& get_crypto() override { return this->crypto_; }
+
+			size_t get_bytes() const { return this->bytes_; }
+
+		private:
+			crypto_session crypto_;
+			size_t bytes_ = 0;
+		};
+
+		void fill(bdFileInfo* info, const size_t index)
+		{
+			info->file_id = index;
+			info->create_time = 1337;
+			info->modified_time = 1337;
+			info->priv = false;
+			info->owner_id = 0x110000100000001;
+			info->filename = "mpdata";
+			info->file_size = 8192;
+		}
+
+		// How service_reply worked before the arena: heap objects behind shared_ptr,
+		// a growing buffer and an encrypted_reply copying it into the frame
+		void send_reference(null_server& server, const size_t count)
+		{
+			const auto reply = server.create_message(1);
+
+			std::vector<std::shared_ptr<i_serializable>> objects;
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto* info = new bdFileInfo;
+				fill(info, i);
+				objects.push_back(std::shared_ptr<i_serializable>(info));
+			}
+
+			byte_buffer buffer;
+			buffer.write_uint64(1);
+			buffer.write_uint32(0);
+			buffer.write_byte(7);
+			buffer.write_uint32(uint32_t(objects.size()));
+			buffer.write_uint32(uint32_t(objects.size()));
+
+			for (auto& object : objects)
+			{
+				object->serialize(&buffer);
+			}
+
+			reply->send(&buffer, true);
+		}
+
+		void send_arena(null_server& server, const size_t count)
+		{
+			const auto reply = server.create_reply(7);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				fill(reply->create<bdFileInfo>(), i);
+			}
+
+			reply->send();
+		}
+
+		template <typename F>
+		void measure(const char* name, const size_t count, const std::chrono::seconds duration, F&& callback)
+		{
+			null_server server;
+
+			size_t replies = 0;
+			const auto allocations = get_allocation_count();
+			const auto start = std::chrono::high_resolution_clock::now();
+			const auto end = start + duration;
+
+			while (std::chrono::high_resolution_clock::now() < end)
+			{
+				callback(server, count);
+				++replies;
+			}
+
+			const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+			const auto allocated = get_allocation_count() - allocations;
+
+			printf("%12s %8zu %12zu %14.1f %12.2f\n", name, count, replies,
+			       replies ? static_cast<double>(allocated) / replies : 0.0,
+			       replies ? elapsed.count() / replies : 0.0);
+		}
+	}
+
+	void run_reply_benchmark(const std::chrono::seconds duration)
+	{
+		const auto step = std::max(duration / 6, std::chrono::seconds(1));
+
+		printf("Service replies carrying bdFileInfo results, %zus per row\n", static_cast<size_t>(step.count()));
+		printf("%12s %8s %12s %14s %12s\n", "reply", "results", "replies", "allocations", "us/reply");
+
+		for (const auto count : {1, 16, 128})
+		{
+			measure("reference", count, step, send_reference);
+			measure("arena", count, step, send_arena);
+		}
+	}
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace demonware
+{
+	// Allocations and time per service reply, old shared_ptr objects against the reply arena
+	void run_reply_benchmark(std::chrono::seconds duration);
+}
@@ -0,0 +1,119 @@
+#include <std_include.hpp>
+#include "report.hpp"
+#include "utils/io.hpp"
+#include "utils/string.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		uint32_t get_percentile(const std::vector<uint32_t>& sorted, const double percentile)
+		{
+			if (sorted.empty()) return 0;
+
+			const auto index = static_cast<size_t>(percentile * static_cast<double>(sorted.size()));
+			return sorted[std::min(index, sorted.size() - 1)];
+		}
+	}
+
+	report::report() : samples_(get_request_infos().size())
+	{
+	}
+
+	void report::add(const client::completion& completion)
+	{
+		auto& samples = this->samples_[static_cast<size_t>(completion.kind)];
+		samples.latencies.push_back(static_cast<uint32_t>(completion.latency.count()));
+		if (completion.error) ++samples.errors;
+	}
+
+	void report::merge(report&& other)
+	{
+		for (size_t i = 0; i < this->samples_.size(); ++i)
+		{
+			auto& samples = this->samples_[i];
+			auto& other_samples = other.samples_[i];
+
+			samples.errors += other_samples.errors;
+			samples.latencies.insert(samples.latencies.end(), other_samples.latencies.begin(),
+			                         other_samples.latencies.end());
+		}
+
+		other.samples_.clear();
+	}
+
+	report::summary report::get_summary(const request_kind kind, const std::chrono::duration<double> duration)
+	{
+		auto& samples = this->samples_[static_cast<size_t>(kind)];
+		std::sort(samples.latencies.begin(), samples.latencies.end());
+
+		summary summary{};
+		summary.requests = samples.latencies.size();
+		summary.errors = samples.errors;
+		summary.requests_per_second = duration.count() > 0 ? summary.requests / duration.count() : 0.0;
+
+		if (summary.requests)
+		{
+			uint64_t total = 0;
+			for (const auto latency : samples.latencies) total += latency;
+
+			summary.mean_us = static_cast<double>(total) / summary.requests;
+			summary.p50_us = get_percentile(samples.latencies, 0.5);
+			summary.p99_us = get_percentile(samples.latencies, 0.99);
+			summary.p999_us = get_percentile(samples.latencies, 0.999);
+			summary.max_us = samples.latencies.back();
+		}
+
+		return summary;
+	}
+
+	void report::print(const std::chrono::duration<double> duration)
+	{
+		printf("%-22s %6s %4s %10s %10s %8s %8s %8s %8s %8s\n", "request", "type", "sub", "requests", "req/s", "errors",
+		       "p50 us", "p99 us", "p999 us", "max us");
+
+		for (const auto& info : get_request_infos())
+		{
+			const auto summary = this->get_summary(info.kind, duration);
+			if (!summary.requests) continue;
+
+			printf("%-22s %6d %4d %10llu %10.1f %8llu %8u %8u %8u %8u\n", info.name, info.type, info.sub_type,
+			       summary.requests, summary.requests_per_second, summary.errors, summary.p50_us, summary.p99_us,
+			       summary.p999_us, summary.max_us);
+		}
+	}
+
+	bool report::write_json(const std::string& file, const std::string& mode, const size_t clients,
+	                        const std::chrono::duration<double> duration)
+	{
+		uint64_t requests = 0, errors = 0;
+		std::string entries;
+
+		for (const auto& info : get_request_infos())
+		{
+			const auto summary = this->get_summary(info.kind, duration);
+			if (!summary.requests) continue;
+
+			requests += summary.requests;
+			errors += summary.errors;
+
+			if (!entries.empty()) entries.append(",\n");
+			entries.append(utils::string::va(
+				"    {\"name\": \"%s\", \"type\": %d, \"sub_type\": %d, \"requests\": %llu, \"errors\": %llu, "
+				"\"requests_per_second\": %.2f, \"latency_us\": {\"mean\": %.1f, \"p50\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}}",
+				info.name, info.type, info.sub_type, summary.requests, summary.errors, summary.requests_per_second,
+				summary.mean_us, summary.p50_us, summary.p99_us, summary.p999_us, summary.max_us));
+		}
+
+		std::string json = utils::string::va(
+			"{\n  \"mode\": \"%s\",\n  \"clients\": %zu,\n  \"duration_s\": %.2f,\n  \"requests\": %llu,\n  \"errors\": %llu,\n"
+			"  \"requests_per_second\": %.2f,\n  \"services\": [\n",
+			mode.data(), clients, duration.count(), requests, errors,
+			duration.count() > 0 ? requests / duration.count() : 0.0);
+
+		json.append(entries);
+		json.append("\n  ]\n}\n");
+
+		return utils::io::write_file(file, json);
+	}
+}
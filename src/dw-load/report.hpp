@@ -0,0 +1,42 @@
+#pragma once
+#include "client.hpp"
+
+namespace demonware
+{
+	// Latencies and error counts per request kind
+	class report final
+	{
+	public:
+		struct summary
+		{
+			uint64_t requests;
+			uint64_t errors;
+			double requests_per_second;
+			double mean_us;
+			uint32_t p50_us;
+			uint32_t p99_us;
+			uint32_t p999_us;
+			uint32_t max_us;
+		};
+
+		report();
+
+		void add(const client::completion& completion);
+		void merge(report&& other);
+
+		summary get_summary(request_kind kind, std::chrono::duration<double> duration);
+
+		void print(std::chrono::duration<double> duration);
+		bool write_json(const std::string& file, const std::string& mode, size_t clients,
+		                std::chrono::duration<double> duration);
+
+	private:
+		struct samples
+		{
+			uint64_t errors = 0;
+			std::vector<uint32_t> latencies;
+		};
+
+		std::vector<samples> samples_;
+	};
+}
@@ -0,0 +1,153 @@
+#include <std_include.hpp>
+#include "socket_benchmark.hpp"
+#include "utils/concurrency.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		// The game has a handful of DemonWare sockets and lots of other traffic
+		constexpr size_t emulated_socket_count = 64;
+		constexpr size_t game_socket_count = 4096;
+		constexpr uint32_t emulated_percentage = 5;
+
+		// One in this many lookups closes and relinks an emulated socket
+		constexpr uint32_t churn_interval = 1000;
+
+		SOCKET get_socket(const size_t index)
+		{
+			// Winsock handles are multiples of 4
+			return static_cast<SOCKET>(0x100 + index * 4);
+		}
+
+		// The tables as they were: std::map behind one recursive mutex
+		class global_table final
+		{
+		public:
+			void link(const SOCKET s)
+			{
+				std::lock_guard _(this->mutex_);
+				this->links_[s] = std::make_shared<int>(0);
+			}
+
+			void unlink(const SOCKET s)
+			{
+				std::lock_guard _(this->mutex_);
+				this->links_.erase(s);
+			}
+
+			std::shared_ptr<int> find(const SOCKET s)
+			{
+				std::lock_guard _(this->mutex_);
+
+				const auto link = this->links_.find(s);
+				if (link != this->links_.end())
+				{
+					return link->second;
+				}
+
+				return {};
+			}
+
+		private:
+			std::recursive_mutex mutex_;
+			std::map<SOCKET, std::shared_ptr<int>> links_;
+		};
+
+		class sharded_table final
+		{
+		public:
+			void link(const SOCKET s)
+			{
+				const auto created = this->links_.access(s, [](std::shared_ptr<int>& link)
+				{
+					link = std::make_shared<int>(0);
+				});
+
+				if (created) this->filter_.add(s);
+			}
+
+			void unlink(const SOCKET s)
+			{
+				if (this->links_.erase(s)) this->filter_.remove(s);
+			}
+
+			std::shared_ptr<int> find(const SOCKET s)
+			{
+				if (!this->filter_.may_contain(s)) return {};
+				return this->links_.find(s).value_or(nullptr);
+			}
+
+		private:
+			utils::concurrency::counting_filter<> filter_;
+			utils::concurrency::sharded_map<SOCKET, std::shared_ptr<int>> links_;
+		};
+
+		template <typename Table>
+		double measure(const size_t thread_count, const std::chrono::seconds duration)
+		{
+			Table table;
+			for (size_t i = 0; i < emulated_socket_count; ++i)
+			{
+				table.link(get_socket(i));
+			}
+
+			std::atomic<bool> stopped = false;
+			std::atomic<uint64_t> total = 0;
+			std::vector<std::thread> threads;
+
+			for (size_t i = 0; i < thread_count; ++i)
+			{
+				threads.emplace_back([&table, &stopped, &total, i]()
+				{
+					std::mt19937 generator(static_cast<uint32_t>(i));
+					std::uniform_int_distribution<uint32_t> percentage(0, 99);
+					std::uniform_int_distribution<size_t> emulated(0, emulated_socket_count - 1);
+					std::uniform_int_distribution<size_t> game(emulated_socket_count,
+					                                           emulated_socket_count + game_socket_count - 1);
+
+					uint64_t operations = 0;
+					while (!stopped.load(std::memory_order_relaxed))
+					{
+						if (++operations % churn_interval == 0)
+						{
+							const auto s = get_socket(emulated(generator));
+							table.unlink(s);
+							table.link(s);
+							continue;
+						}
+
+						const auto is_emulated = percentage(generator) < emulated_percentage;
+						table.find(get_socket(is_emulated ? emulated(generator) : game(generator)));
+					}
+
+					total += operations;
+				});
+			}
+
+			std::this_thread::sleep_for(duration);
+			stopped = true;
+
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			return static_cast<double>(total) / static_cast<double>(duration.count());
+		}
+	}
+
+	void run_socket_benchmark(const std::chrono::seconds duration)
+	{
+		printf("Socket lookups, %u%% emulated, %zus per run\n", emulated_percentage, static_cast<size_t>(duration.count()));
+		printf("%8s %16s %16s %8s\n", "threads", "global ops/s", "sharded ops/s", "speedup");
+
+		for (size_t threads = 1; threads <= 8; threads *= 2)
+		{
+			const auto global = measure<global_table>(threads, duration);
+			const auto sharded = measure<sharded_table>(threads, duration);
+
+			printf("%8zu %16.0f %16.0f %7.1fx\n", threads, global, sharded, global > 0 ? sharded / global : 0.0);
+		}
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace demonware
+{
+	// Compares the socket lookups of the dw module, one global lock against
+	// a counting filter in front of sharded maps, with 1 to 8 threads
+	void run_socket_benchmark(std::chrono::seconds duration);
+}
@@ -0,0 +1,145 @@
+#include <std_include.hpp>
+#include "storage_benchmark.hpp"
+#include "game/demonware/user_storage.hpp"
+#include "utils/io.hpp"
+#include "utils/string.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr auto directory = "dw-load/storage";
+		constexpr size_t file_count = 2000;
+		constexpr size_t file_size = 8 * 1024;
+
+		// Only holds a few files, nearly every random read below goes to the disk
+		constexpr size_t cache_size = 4 * file_size;
+
+		// One in this many players still has the default stats
+		constexpr size_t default_interval = 4;
+
+		// Stats are mostly zeroed counters with a few values set
+		std::string generate_file(const size_t index, std::mt19937& generator)
+		{
+			std::string data(file_size, '\0');
+			if (index % default_interval == 0) return data;
+
+			std::uniform_int_distribution<size_t> offset(0, file_size / sizeof(uint32_t) - 1);
+			std::uniform_int_distribution<uint32_t> value(0, 1000);
+
+			for (auto i = 0; i < 256; ++i)
+			{
+				const auto counter = value(generator);
+				std::memcpy(data.data() + offset(generator) * sizeof(uint32_t), &counter, sizeof(counter));
+			}
+
+			return data;
+		}
+
+		uint64_t get_directory_size(const std::string& path)
+		{
+			uint64_t size = 0;
+
+			std::error_code error;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+			{
+				if (entry.is_regular_file()) size += entry.file_size();
+			}
+
+			return size;
+		}
+
+		void print_latency(const char* name, std::vector<double>& samples)
+		{
+			if (samples.empty()) return;
+
+			std::sort(samples.begin(), samples.end());
+
+			const auto percentile = [&samples](const double value)
+			{
+				return samples[std::min(static_cast<size_t>(value * samples.size()), samples.size() - 1)];
+			};
+
+			printf("%16s %10zu %12.1f %12.1f\n", name, samples.size(), percentile(0.5), percentile(0.99));
+		}
+
+		template <typename F>
+		std::vector<double> measure(const std::chrono::seconds duration, std::mt19937& generator, F&& callback)
+		{
+			std::vector<double> samples;
+			std::uniform_int_distribution<size_t> file(0, file_count - 1);
+
+			const auto end = std::chrono::high_resolution_clock::now() + duration;
+			while (std::chrono::high_resolution_clock::now() < end)
+			{
+				const auto index = file(generator);
+				const auto start = std::chrono::high_resolution_clock::now();
+
+				if (!callback(index)) return {};
+
+				const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+				samples.push_back(elapsed.count());
+			}
+
+			return samples;
+		}
+	}
+
+	void run_storage_benchmark(const std::chrono::seconds duration)
+	{
+		std::error_code error;
+		std::filesystem::remove_all(directory, error);
+
+		const std::string flat_directory = directory + "/flat"s;
+		const std::string store_directory = directory + "/user"s;
+
+		std::mt19937 generator(1337);
+		uint64_t logical_bytes = 0;
+
+		{
+			user_storage storage(store_directory, cache_size, 1h);
+
+			for (size_t i = 0; i < file_count; ++i)
+			{
+				const auto id = utils::string::va("%zX", i);
+				auto data = generate_file(i, generator);
+
+				logical_bytes += data.size();
+				utils::io::write_file(flat_directory + "/" + id, data);
+				storage.write(id, std::move(data), i, id, 0, false);
+			}
+
+			storage.flush();
+		}
+
+		const auto flat_bytes = get_directory_size(flat_directory);
+		const auto store_bytes = get_directory_size(store_directory + ".blobs") + utils::io::file_size(
+			store_directory + ".index");
+
+		printf("%zu user files of %zu bytes, every %zuth one left at its defaults\n", file_count, file_size,
+		       default_interval);
+		printf("%16s %14llu bytes\n", "logical", logical_bytes);
+		printf("%16s %14llu bytes\n", "flat files", flat_bytes);
+		printf("%16s %14llu bytes (%.1f%% saved)\n", "blobs and index", store_bytes,
+		       flat_bytes ? 100.0 - 100.0 * static_cast<double>(store_bytes) / static_cast<double>(flat_bytes) : 0.0);
+
+		printf("\n%16s %10s %12s %12s\n", "cold read", "reads", "p50 us", "p99 us");
+
+		auto flat = measure(duration, generator, [&](const size_t index)
+		{
+			std::string data;
+			return utils::io::read_file(flat_directory + "/" + utils::string::va("%zX", index), &data);
+		});
+
+		print_latency("flat file", flat);
+
+		user_storage storage(store_directory, cache_size, 1h);
+		auto blobs = measure(duration, generator, [&](const size_t index)
+		{
+			std::string data;
+			return storage.read(utils::string::va("%zX", index), &data);
+		});
+
+		print_latency("blob", blobs);
+	}
+}
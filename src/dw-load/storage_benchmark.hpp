@@ -0,0 +1,7 @@
+#pragma once
+
+namespace demonware
+{
+	// Disk usage and cold read latency of the blob store against flat files
+	void run_storage_benchmark(std::chrono::seconds duration);
+}
@@ -0,0 +1,106 @@
+#include <std_include.hpp>
+#include "transport.hpp"
+
+namespace demonware
+{
+	session_transport::session_transport(std::shared_ptr<service_session> session) : session_(std::move(session))
+	{
+	}
+
+	bool session_transport::send(const std::string& data)
+	{
+		return this->session_->send(data.data(), static_cast<int>(data.size())) == static_cast<int>(data.size());
+	}
+
+	bool session_transport::receive(std::string* buffer)
+	{
+		char data[0x2000];
+
+		int length;
+		while ((length = this->session_->recv(data, sizeof(data))) > 0)
+		{
+			buffer->append(data, length);
+		}
+
+		return true;
+	}
+
+	const std::shared_ptr<service_session>& session_transport::get_session() const
+	{
+		return this->session_;
+	}
+
+	socket_transport::socket_transport(const SOCKET socket) : socket_(socket)
+	{
+	}
+
+	socket_transport::~socket_transport()
+	{
+		closesocket(this->socket_);
+	}
+
+	std::unique_ptr<socket_transport> socket_transport::connect(const sockaddr_in& address)
+	{
+		const auto socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (socket == INVALID_SOCKET) return {};
+
+		std::unique_ptr<socket_transport> transport(new socket_transport(socket));
+
+		if (::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+		{
+			return {};
+		}
+
+		const BOOL no_delay = TRUE;
+		setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+		u_long non_blocking = 1;
+		ioctlsocket(socket, FIONBIO, &non_blocking);
+
+		return transport;
+	}
+
+	bool socket_transport::send(const std::string& data)
+	{
+		size_t offset = 0;
+		while (offset < data.size())
+		{
+			const auto result = ::send(this->socket_, data.data() + offset, static_cast<int>(data.size() - offset), 0);
+			if (result == SOCKET_ERROR)
+			{
+				if (WSAGetLastError() != WSAEWOULDBLOCK) return false;
+
+				// Requests are small, the send buffer drains quickly
+				std::this_thread::yield();
+				continue;
+			}
+
+			offset += result;
+		}
+
+		return true;
+	}
+
+	bool socket_transport::receive(std::string* buffer)
+	{
+		char data[0x2000];
+
+		while (true)
+		{
+			const auto result = recv(this->socket_, data, sizeof(data), 0);
+			if (result == 0) return false;
+
+			if (result == SOCKET_ERROR)
+			{
+				return WSAGetLastError() == WSAEWOULDBLOCK;
+			}
+
+			buffer->append(data, result);
+		}
+	}
+
+	SOCKET socket_transport::get_socket() const
+	{
+		return this->socket_;
+	}
+}
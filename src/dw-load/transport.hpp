@@ -0,0 +1,56 @@
+#pragma once
+#include "game/demonware/service_session.hpp"
+
+namespace demonware
+{
+	// Carries frames between a simulated client and the emulator
+	class transport
+	{
+	public:
+		virtual ~transport() = default;
+
+		virtual bool send(const std::string& data) = 0;
+
+		// Appends whatever arrived without blocking, returns false once the connection is gone
+		virtual bool receive(std::string* buffer) = 0;
+	};
+
+	// Talks to a session of an in-process core, the way the game module does
+	class session_transport final : public transport
+	{
+	public:
+		explicit session_transport(std::shared_ptr<service_session> session);
+
+		bool send(const std::string& data) override;
+		bool receive(std::string* buffer) override;
+
+		const std::shared_ptr<service_session>& get_session() const;
+
+	private:
+		std::shared_ptr<service_session> session_;
+	};
+
+	// Talks to dw-server over a non-blocking TCP socket
+	class socket_transport final : public transport
+	{
+	public:
+		~socket_transport() override;
+
+		socket_transport(socket_transport&&) = delete;
+		socket_transport(const socket_transport&) = delete;
+		socket_transport& operator=(socket_transport&&) = delete;
+		socket_transport& operator=(const socket_transport&) = delete;
+
+		static std::unique_ptr<socket_transport> connect(const sockaddr_in& address);
+
+		bool send(const std::string& data) override;
+		bool receive(std::string* buffer) override;
+
+		SOCKET get_socket() const;
+
+	private:
+		explicit socket_transport(SOCKET socket);
+
+		SOCKET socket_;
+	};
+}
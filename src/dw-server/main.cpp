@@ -0,0 +1,146 @@
+#include <std_include.hpp>
+#include "network.hpp"
+
+namespace
+{
+	struct options
+	{
+		uint16_t lobby_port = 3074;
+		uint16_t auth_port = 3075;
+		uint16_t stun_port = 3478;
+		size_t network_threads = 2;
+		std::chrono::seconds stats_interval = 0s;
+		demonware::core::settings settings;
+	};
+
+	std::mutex exit_mutex;
+	std::condition_variable exit_signal;
+	bool exit_requested = false;
+
+	BOOL WINAPI console_handler(DWORD /*type*/)
+	{
+		{
+			std::lock_guard _(exit_mutex);
+			exit_requested = true;
+		}
+
+		exit_signal.notify_all();
+		return TRUE;
+	}
+
+	options parse_options(const int argc, char** argv)
+	{
+		options options{};
+		options.settings.worker_count = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+
+		for (auto i = 1; i + 1 < argc; i += 2)
+		{
+			const std::string name = argv[i];
+			const std::string value = argv[i + 1];
+
+			if (name == "-lobby_port") options.lobby_port = static_cast<uint16_t>(std::atoi(value.data()));
+			else if (name == "-auth_port") options.auth_port = static_cast<uint16_t>(std::atoi(value.data()));
+			else if (name == "-stun_port") options.stun_port = static_cast<uint16_t>(std::atoi(value.data()));
+			else if (name == "-network_threads") options.network_threads = std::max(1, std::atoi(value.data()));
+			else if (name == "-workers") options.settings.worker_count = std::max(1, std::atoi(value.data()));
+			else if (name == "-storage") options.settings.storage_directory = value;
+			else if (name == "-nat")
+			{
+				const auto type = demonware::nat_simulator::parse_type(value);
+				if (type) options.settings.nat_type = *type;
+				else printf("Unknown NAT type %s\n", value.data());
+			}
+			else if (name == "-stats") options.stats_interval = std::chrono::seconds(std::max(0, std::atoi(value.data())));
+			else printf("Unknown option %s\n", name.data());
+		}
+
+		return options;
+	}
+
+	void dump_statistics(demonware::core& core, const demonware::network& network)
+	{
+		printf("DW: %zu connections\n", network.get_connection_count());
+		core.dump_statistics([](const char* line)
+		{
+			printf("%s", line);
+		});
+	}
+}
+
+int main(const int argc, char** argv)
+{
+	const auto options = parse_options(argc, argv);
+
+	WSADATA wsa_data;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa_data))
+	{
+		printf("Failed to initialize Winsock\n");
+		return 1;
+	}
+
+	const auto _ = gsl::finally([]()
+	{
+		WSACleanup();
+	});
+
+	try
+	{
+		demonware::core core(options.settings);
+		core.register_default_servers();
+
+		{
+			demonware::network network(options.network_threads);
+
+			const auto lobby = core.find_server_by_name("mw3-pc-lobby.prod.demonware.net");
+			const auto auth = core.find_server_by_name("mw3-pc-auth.prod.demonware.net");
+			const auto stun = core.find_stun_server_by_name("mw3-stun.us.demonware.net");
+
+			if (!network.listen(lobby, options.lobby_port)
+				|| !network.listen(auth, options.auth_port)
+				|| !network.listen(stun, options.stun_port))
+			{
+				printf("Failed to bind the server ports\n");
+				return 1;
+			}
+
+			printf("DW: Serving lobby on port %hu, auth on port %hu and STUN on port %hu (NAT %s) with %zu workers\n",
+			       options.lobby_port, options.auth_port, options.stun_port,
+			       demonware::nat_simulator::get_type_name(options.settings.nat_type), options.settings.worker_count);
+
+			SetConsoleCtrlHandler(console_handler, TRUE);
+
+			std::unique_lock lock(exit_mutex);
+			while (!exit_requested)
+			{
+				if (options.stats_interval.count() > 0)
+				{
+					if (!exit_signal.wait_for(lock, options.stats_interval, []()
+					{
+						return exit_requested;
+					}))
+					{
+						dump_statistics(core, network);
+					}
+				}
+				else
+				{
+					exit_signal.wait(lock, []()
+					{
+						return exit_requested;
+					});
+				}
+			}
+
+			dump_statistics(core, network);
+		}
+
+		// The network is gone at this point, the core drains the workers and flushes the storage
+	}
+	catch (std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,454 @@
+#include <std_include.hpp>
+#include "network.hpp"
+#include "utils/string.hpp"
+#include "utils/thread.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr size_t max_send_size = 0x10000;
+
+		SOCKET create_socket(const int type, const int protocol, const uint16_t port)
+		{
+			const auto socket = WSASocketW(AF_INET, type, protocol, nullptr, 0, WSA_FLAG_OVERLAPPED);
+			if (socket == INVALID_SOCKET) return INVALID_SOCKET;
+
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_addr.s_addr = htonl(INADDR_ANY);
+			address.sin_port = htons(port);
+
+			if (bind(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+			{
+				closesocket(socket);
+				return INVALID_SOCKET;
+			}
+
+			return socket;
+		}
+
+		// Errors that don't mean the listening socket is gone
+		bool is_transient_error(const int error)
+		{
+			return error == WSAECONNRESET || error == WSAEMSGSIZE || error == WSAEMFILE || error == WSAENOBUFS;
+		}
+	}
+
+	class network::connection final : public std::enable_shared_from_this<connection>
+	{
+	public:
+		// Keeps the connection alive while the operation is posted
+		struct operation : OVERLAPPED
+		{
+			std::shared_ptr<connection> owner;
+		};
+
+		connection(network* owner, const SOCKET socket, std::shared_ptr<service_session> session)
+			: network_(owner), socket_(socket), session_(std::move(session))
+		{
+		}
+
+		~connection()
+		{
+			const auto socket = this->socket_.exchange(INVALID_SOCKET);
+			if (socket != INVALID_SOCKET) closesocket(socket);
+
+			this->network_->remove_connection(this);
+		}
+
+		connection(connection&&) = delete;
+		connection(const connection&) = delete;
+		connection& operator=(connection&&) = delete;
+		connection& operator=(const connection&) = delete;
+
+		void start()
+		{
+			std::weak_ptr<connection> weak = this->shared_from_this();
+			this->session_->set_reply_handler([weak]()
+			{
+				const auto self = weak.lock();
+				if (self) self->send();
+			});
+
+			this->receive();
+		}
+
+		void close()
+		{
+			if (this->closed_.exchange(true)) return;
+
+			// The handle is only released once no operation references it anymore,
+			// otherwise a new connection could get it while a send is still being posted
+			shutdown(this->socket_, SD_BOTH);
+			CancelIoEx(reinterpret_cast<HANDLE>(this->socket_.load()), nullptr);
+		}
+
+		// Releasing the handle completes every operation still pending on it.
+		// Only used during teardown, when cancelling them was not enough.
+		void abort()
+		{
+			this->close();
+
+			const auto socket = this->socket_.exchange(INVALID_SOCKET);
+			if (socket != INVALID_SOCKET) closesocket(socket);
+		}
+
+		void send()
+		{
+			if (this->sending_.exchange(true)) return;
+			this->send_next();
+		}
+
+		void complete(const operation* operation, const bool success, const DWORD bytes)
+		{
+			if (operation == &this->receive_operation_)
+			{
+				if (!success || !bytes)
+				{
+					this->close();
+					return;
+				}
+
+				this->session_->send(this->receive_buffer_, static_cast<int>(bytes));
+				this->receive();
+			}
+			else
+			{
+				if (!success)
+				{
+					this->sending_ = false;
+					this->close();
+					return;
+				}
+
+				this->session_->consume(bytes);
+				this->send_next();
+			}
+		}
+
+	private:
+		network* network_;
+		std::atomic<SOCKET> socket_;
+		std::shared_ptr<service_session> session_;
+
+		std::atomic<bool> closed_{false};
+		std::atomic<bool> sending_{false};
+
+		operation receive_operation_{};
+		char receive_buffer_[0x2000];
+
+		operation send_operation_{};
+		std::vector<WSABUF> send_buffers_;
+
+		void receive()
+		{
+			if (this->closed_) return;
+
+			WSABUF buffer{static_cast<ULONG>(sizeof(this->receive_buffer_)), this->receive_buffer_};
+			DWORD flags = 0;
+
+			std::memset(static_cast<OVERLAPPED*>(&this->receive_operation_), 0, sizeof(OVERLAPPED));
+			this->receive_operation_.owner = this->shared_from_this();
+
+			if (WSARecv(this->socket_, &buffer, 1, nullptr, &flags, &this->receive_operation_, nullptr) == SOCKET_ERROR
+				&& WSAGetLastError() != WSA_IO_PENDING)
+			{
+				this->receive_operation_.owner.reset();
+				this->close();
+			}
+		}
+
+		// Only called by the thread that set sending_
+		void send_next()
+		{
+			std::vector<std::string_view> views;
+			if (this->closed_ || !this->session_->gather(&views, max_send_size))
+			{
+				this->sending_ = false;
+
+				// Replies queued after the gather above saw the flag still set and left them to us
+				if (this->closed_ || !this->session_->gather(&views, max_send_size) || this->sending_.exchange(true))
+				{
+					return;
+				}
+			}
+
+			this->send_buffers_.clear();
+			for (const auto& view : views)
+			{
+				this->send_buffers_.push_back({static_cast<ULONG>(view.size()), const_cast<char*>(view.data())});
+			}
+
+			std::memset(static_cast<OVERLAPPED*>(&this->send_operation_), 0, sizeof(OVERLAPPED));
+			this->send_operation_.owner = this->shared_from_this();
+
+			// The views stay valid until the completion consumes them
+			if (WSASend(this->socket_, this->send_buffers_.data(), static_cast<DWORD>(this->send_buffers_.size()), nullptr,
+			            0, &this->send_operation_, nullptr) == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING)
+			{
+				this->send_operation_.owner.reset();
+				this->sending_ = false;
+				this->close();
+			}
+		}
+	};
+
+	network::network(const size_t thread_count)
+	{
+		this->port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, static_cast<DWORD>(thread_count));
+		if (!this->port_)
+		{
+			throw std::runtime_error("Failed to create completion port");
+		}
+
+		for (size_t i = 0; i < std::max(thread_count, size_t(1)); ++i)
+		{
+			this->threads_.emplace_back(utils::thread::create_named_thread(utils::string::va("DW Network %zu", i), [this]()
+			{
+				this->worker();
+			}));
+		}
+	}
+
+	network::~network()
+	{
+		this->stopped_ = true;
+
+		// Unblocks accept and recvfrom
+		for (auto& listener : this->listeners_)
+		{
+			closesocket(listener.socket);
+		}
+
+		for (auto& listener : this->listeners_)
+		{
+			if (listener.thread.joinable())
+			{
+				listener.thread.join();
+			}
+		}
+
+		const auto get_connections = [this]()
+		{
+			std::vector<std::shared_ptr<connection>> connections;
+			for (const auto& entry : this->connections_)
+			{
+				if (auto connection = entry.second.lock()) connections.push_back(std::move(connection));
+			}
+
+			return connections;
+		};
+
+		std::unique_lock lock(this->connection_mutex_);
+		auto connections = get_connections();
+		lock.unlock();
+
+		for (const auto& connection : connections)
+		{
+			connection->close();
+		}
+
+		connections.clear();
+		lock.lock();
+
+		// Cancelled operations still complete, which releases the last references.
+		// Connections call back into the network when destroyed, so none may outlive it.
+		while (!this->connection_signal_.wait_for(lock, 5s, [this]()
+		{
+			return this->connections_.empty();
+		}))
+		{
+			printf("DW: %zu connections did not close in time, releasing their sockets\n", this->connections_.size());
+
+			connections = get_connections();
+			lock.unlock();
+
+			for (const auto& connection : connections)
+			{
+				connection->abort();
+			}
+
+			connections.clear();
+			lock.lock();
+		}
+
+		lock.unlock();
+
+		for (size_t i = 0; i < this->threads_.size(); ++i)
+		{
+			PostQueuedCompletionStatus(this->port_, 0, 0, nullptr);
+		}
+
+		for (auto& thread : this->threads_)
+		{
+			if (thread.joinable())
+			{
+				thread.join();
+			}
+		}
+
+		CloseHandle(this->port_);
+	}
+
+	bool network::listen(const std::shared_ptr<service_server>& server, const uint16_t port)
+	{
+		const auto socket = create_socket(SOCK_STREAM, IPPROTO_TCP, port);
+		if (socket == INVALID_SOCKET) return false;
+
+		if (::listen(socket, SOMAXCONN) == SOCKET_ERROR)
+		{
+			closesocket(socket);
+			return false;
+		}
+
+		std::lock_guard _(this->listener_mutex_);
+		this->listeners_.push_back({
+			socket, utils::thread::create_named_thread("DW Accept", [this, socket, server]()
+			{
+				this->accept_connections(socket, server);
+			})
+		});
+
+		return true;
+	}
+
+	bool network::listen(const std::shared_ptr<stun_server>& server, const uint16_t port)
+	{
+		const auto socket = create_socket(SOCK_DGRAM, IPPROTO_UDP, port);
+		if (socket == INVALID_SOCKET) return false;
+
+		std::lock_guard _(this->listener_mutex_);
+		this->listeners_.push_back({
+			socket, utils::thread::create_named_thread("DW STUN", [this, socket, server]()
+			{
+				this->answer_datagrams(socket, server);
+			})
+		});
+
+		return true;
+	}
+
+	size_t network::get_connection_count() const
+	{
+		std::lock_guard _(this->connection_mutex_);
+		return this->connections_.size();
+	}
+
+	void network::accept_connections(const SOCKET socket, const std::shared_ptr<service_server> server)
+	{
+		while (!this->stopped_)
+		{
+			const auto client = accept(socket, nullptr, nullptr);
+			if (client == INVALID_SOCKET)
+			{
+				const auto error = WSAGetLastError();
+				if (this->stopped_ || !is_transient_error(error)) break;
+
+				std::this_thread::sleep_for(10ms);
+				continue;
+			}
+
+			// Replies are small and latency bound
+			const BOOL no_delay = TRUE;
+			setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+			if (!CreateIoCompletionPort(reinterpret_cast<HANDLE>(client), this->port_, 0, 0))
+			{
+				closesocket(client);
+				continue;
+			}
+
+			const auto connection = std::make_shared<network::connection>(this, client, server->create_session());
+			this->add_connection(connection);
+			connection->start();
+		}
+	}
+
+	void network::answer_datagrams(const SOCKET socket, const std::shared_ptr<stun_server> server)
+	{
+		constexpr size_t max_batch_size = 64;
+
+		char buffer[0x800];
+		std::vector<stun_datagram> batch;
+
+		while (!this->stopped_)
+		{
+			// Blocks for the first datagram, then picks up whatever else already arrived
+			batch.clear();
+			while (batch.size() < max_batch_size)
+			{
+				if (!batch.empty())
+				{
+					u_long available = 0;
+					if (ioctlsocket(socket, FIONREAD, &available) == SOCKET_ERROR || !available) break;
+				}
+
+				sockaddr_in from{};
+				int from_length = sizeof(from);
+
+				const auto length = recvfrom(socket, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&from),
+				                             &from_length);
+				if (length == SOCKET_ERROR)
+				{
+					// Unreachable clients show up as resets on UDP sockets
+					if (this->stopped_ || !is_transient_error(WSAGetLastError())) return;
+					continue;
+				}
+
+				const auto port = ntohs(from.sin_port);
+				const auto client = (static_cast<uint64_t>(from.sin_addr.s_addr) << 16) | port;
+
+				batch.push_back({client, {from.sin_addr.s_addr, port}, std::string(buffer, length)});
+			}
+
+			server->handle_packets(&batch);
+
+			for (const auto& datagram : batch)
+			{
+				sockaddr_in to{};
+				to.sin_family = AF_INET;
+				to.sin_addr.s_addr = datagram.source.address;
+				to.sin_port = htons(datagram.source.port);
+
+				sendto(socket, datagram.data.data(), static_cast<int>(datagram.data.size()), 0,
+				       reinterpret_cast<const sockaddr*>(&to), sizeof(to));
+			}
+		}
+	}
+
+	void network::add_connection(const std::shared_ptr<connection>& connection)
+	{
+		std::lock_guard _(this->connection_mutex_);
+		this->connections_[connection.get()] = connection;
+	}
+
+	void network::remove_connection(connection* connection)
+	{
+		{
+			std::lock_guard _(this->connection_mutex_);
+			this->connections_.erase(connection);
+		}
+
+		this->connection_signal_.notify_all();
+	}
+
+	void network::worker()
+	{
+		while (true)
+		{
+			DWORD bytes = 0;
+			ULONG_PTR key = 0;
+			OVERLAPPED* overlapped = nullptr;
+
+			const auto success = GetQueuedCompletionStatus(this->port_, &bytes, &key, &overlapped, INFINITE);
+
+			// Only the destructor posts empty packets
+			if (!overlapped) return;
+
+			auto* operation = static_cast<connection::operation*>(overlapped);
+			const auto owner = std::move(operation->owner);
+			owner->complete(operation, success != FALSE, bytes);
+		}
+	}
+}
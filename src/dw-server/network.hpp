@@ -0,0 +1,53 @@
+#pragma once
+#include "game/demonware/core.hpp"
+
+namespace demonware
+{
+	// Serves the core over real sockets.
+	// Connections are driven by an I/O completion port, so a few threads handle any number of them,
+	// while the services themselves run on the core's workers.
+	class network final
+	{
+	public:
+		explicit network(size_t thread_count);
+		~network();
+
+		network(network&&) = delete;
+		network(const network&) = delete;
+		network& operator=(network&&) = delete;
+		network& operator=(const network&) = delete;
+
+		bool listen(const std::shared_ptr<service_server>& server, uint16_t port);
+		bool listen(const std::shared_ptr<stun_server>& server, uint16_t port);
+
+		size_t get_connection_count() const;
+
+	private:
+		class connection;
+
+		struct listener
+		{
+			SOCKET socket;
+			std::thread thread;
+		};
+
+		HANDLE port_;
+		std::atomic<bool> stopped_{false};
+		std::vector<std::thread> threads_;
+
+		std::mutex listener_mutex_;
+		std::vector<listener> listeners_;
+
+		mutable std::mutex connection_mutex_;
+		std::condition_variable connection_signal_;
+		std::unordered_map<connection*, std::weak_ptr<connection>> connections_;
+
+		void accept_connections(SOCKET socket, std::shared_ptr<service_server> server);
+		void answer_datagrams(SOCKET socket, std::shared_ptr<stun_server> server);
+
+		void add_connection(const std::shared_ptr<connection>& connection);
+		void remove_connection(connection* connection);
+
+		void worker();
+	};
+}
@@ -91,36 +91,49 @@ namespace demonware
 		return this->write(5, &data);
 	}
 
-	bool bit_buffer::read(unsigned int bits, void* output)
+	bool bit_buffer::read(const unsigned int bits, void* output)
 	{
 		if (bits == 0) return false;
 		if ((this->current_bit_ + bits) > (this->buffer_.size() * 8)) return false;
 
-		int cur_byte = this->current_bit_ >> 3;
-		auto cur_out = 0;
+		const auto* input = reinterpret_cast<const uint8_t*>(this->buffer_.data()) + (this->current_bit_ >> 3);
+		auto* output_bytes = static_cast<uint8_t*>(output);
 
-		const char* bytes = this->buffer_.data();
-		const auto output_bytes = reinterpret_cast<unsigned char*>(output);
+		const auto shift = this->current_bit_ & 7;
+		this->current_bit_ += bits;
 
-		while (bits > 0)
+		if (shift == 0)
 		{
-			const int min_bit = (bits < 8) ? bits : 8;
-			const auto this_byte = bytes[cur_byte++] & 0xFF;
-			const int remain = this->current_bit_ & 7;
+			const auto whole_bytes = bits >> 3;
+			std::memcpy(output_bytes, input, whole_bytes);
 
-			if ((min_bit + remain) <= 8)
+			const auto rest = bits & 7;
+			if (rest)
 			{
-				output_bytes[cur_out] = BYTE((0xFF >> (8 - min_bit)) & (this_byte >> remain));
-			}
-			else
-			{
-				output_bytes[cur_out] = BYTE(
-					(0xFF >> (8 - min_bit)) & (bytes[cur_byte] << (8 - remain)) | (this_byte >> remain));
+				output_bytes[whole_bytes] = uint8_t(input[whole_bytes] & ((1u << rest) - 1));
 			}
 
-			cur_out++;
-			this->current_bit_ += min_bit;
-			bits -= min_bit;
+			return true;
+		}
+
+		// Unaligned streams are moved in chunks of up to 56 bits,
+		// so the shifted chunk always fits into a single 64 bit word
+		auto remaining = bits;
+		while (remaining > 0)
+		{
+			const auto count = std::min(remaining, 56u);
+			const auto input_length = (shift + count + 7) >> 3;
+			const auto output_length = (count + 7) >> 3;
+
+			uint64_t word = 0;
+			std::memcpy(&word, input, input_length);
+
+			const auto value = (word >> shift) & ((1ull << count) - 1);
+			std::memcpy(output_bytes, &value, output_length);
+
+			input += count >> 3;
+			output_bytes += output_length;
+			remaining -= count;
 		}
 
 		return true;
@@ -129,36 +142,59 @@ namespace demonware
 	bool bit_buffer::write(const unsigned int bits, const void* data)
 	{
 		if (bits == 0) return false;
-		this->buffer_.resize(this->buffer_.size() + (bits >> 3) + 1);
 
-		int bit = bits;
-		const auto bytes = const_cast<char*>(this->buffer_.data());
-		const auto* input_bytes = reinterpret_cast<const unsigned char*>(data);
+		const size_t required = (this->current_bit_ + bits + 7) >> 3;
+		if (this->buffer_.size() < required)
+		{
+			if (this->buffer_.capacity() < required)
+			{
+				this->buffer_.reserve(std::max(required, this->buffer_.capacity() * 2));
+			}
+
+			this->buffer_.resize(required);
+		}
+
+		const auto* input = static_cast<const uint8_t*>(data);
+		auto* output = reinterpret_cast<uint8_t*>(this->buffer_.data()) + (this->current_bit_ >> 3);
+
+		const auto shift = this->current_bit_ & 7;
+		this->current_bit_ += bits;
 
-		while (bit > 0)
+		if (shift == 0)
 		{
-			const int bit_pos = this->current_bit_ & 7;
-			auto rem_bit = 8 - bit_pos;
-			const auto this_write = (bit < rem_bit) ? bit : rem_bit;
+			const auto whole_bytes = bits >> 3;
+			std::memcpy(output, input, whole_bytes);
 
-			const BYTE mask = ((0xFF >> rem_bit) | (0xFF << (bit_pos + this_write)));
-			const int byte_pos = this->current_bit_ >> 3;
+			const auto rest = bits & 7;
+			if (rest)
+			{
+				const auto mask = uint8_t((1u << rest) - 1);
+				output[whole_bytes] = uint8_t((output[whole_bytes] & ~mask) | (input[whole_bytes] & mask));
+			}
 
-			const BYTE temp_byte = (mask & bytes[byte_pos]);
-			const BYTE this_bit = ((bits - bit) & 7);
-			const auto this_byte = (bits - bit) >> 3;
+			return true;
+		}
 
-			auto this_data = input_bytes[this_byte];
+		auto remaining = bits;
+		while (remaining > 0)
+		{
+			const auto count = std::min(remaining, 56u);
+			const auto input_length = (count + 7) >> 3;
+			const auto output_length = (shift + count + 7) >> 3;
+			const auto mask = (1ull << count) - 1;
 
-			const auto next_byte = (((bits - 1) >> 3) > this_byte) ? input_bytes[this_byte + 1] : 0;
+			uint64_t value = 0;
+			std::memcpy(&value, input, input_length);
 
-			this_data = BYTE((next_byte << (8 - this_bit)) | (this_data >> this_bit));
+			uint64_t word = 0;
+			std::memcpy(&word, output, output_length);
 
-			const BYTE out_byte = (~mask & (this_data << bit_pos) | temp_byte);
-			bytes[byte_pos] = out_byte;
+			word = (word & ~(mask << shift)) | ((value & mask) << shift);
+			std::memcpy(output, &word, output_length);
 
-			this->current_bit_ += this_write;
-			bit -= this_write;
+			input += input_length;
+			output += count >> 3;
+			remaining -= count;
 		}
 
 		return true;
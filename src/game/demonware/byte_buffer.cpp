@@ -281,6 +281,11 @@ namespace demonware
 		this->use_data_types_ = use_data_types;
 	}
 
+	void byte_buffer::reserve(const size_t size)
+	{
+		this->buffer_.reserve(size);
+	}
+
 	size_t byte_buffer::size() const
 	{
 		return this->buffer_.size();
@@ -11,6 +11,11 @@ namespace demonware
 		{
 		}
 
+		explicit byte_buffer(const size_t capacity)
+		{
+			this->buffer_.reserve(capacity);
+		}
+
 		bool read_byte(unsigned char* output);
 		bool read_bool(bool* output);
 		bool read_int16(short* output);
@@ -52,6 +57,7 @@ namespace demonware
 		bool write(const std::string& data);
 
 		void set_use_data_types(bool use_data_types);
+		void reserve(size_t size);
 		size_t size() const;
 
 		bool is_using_data_types() const;
@@ -0,0 +1,88 @@
+#include <std_include.hpp>
+#include "byte_queue.hpp"
+
+namespace demonware
+{
+	void byte_queue::push(std::string data)
+	{
+		if (data.empty()) return;
+
+		this->size_ += data.size();
+		this->chunks_.emplace_back(std::move(data));
+	}
+
+	size_t byte_queue::read(void* output, const size_t length)
+	{
+		auto* out = static_cast<char*>(output);
+		size_t total = 0;
+
+		while (total < length && !this->chunks_.empty())
+		{
+			const auto& chunk = this->chunks_.front();
+			const auto count = std::min(length - total, chunk.size() - this->offset_);
+
+			std::memcpy(out + total, chunk.data() + this->offset_, count);
+			total += count;
+
+			this->consume(count);
+		}
+
+		return total;
+	}
+
+	size_t byte_queue::gather(std::vector<std::string_view>* output, const size_t length) const
+	{
+		size_t total = 0;
+		auto offset = this->offset_;
+
+		for (const auto& chunk : this->chunks_)
+		{
+			if (total >= length) break;
+
+			const auto count = std::min(length - total, chunk.size() - offset);
+			output->emplace_back(chunk.data() + offset, count);
+
+			total += count;
+			offset = 0;
+		}
+
+		return total;
+	}
+
+	void byte_queue::consume(size_t length)
+	{
+		length = std::min(length, this->size_);
+		this->size_ -= length;
+
+		while (length > 0)
+		{
+			const auto available = this->chunks_.front().size() - this->offset_;
+			if (length < available)
+			{
+				this->offset_ += length;
+				return;
+			}
+
+			length -= available;
+			this->offset_ = 0;
+			this->chunks_.pop_front();
+		}
+	}
+
+	size_t byte_queue::size() const
+	{
+		return this->size_;
+	}
+
+	bool byte_queue::empty() const
+	{
+		return this->size_ == 0;
+	}
+
+	void byte_queue::clear()
+	{
+		this->chunks_.clear();
+		this->offset_ = 0;
+		this->size_ = 0;
+	}
+}
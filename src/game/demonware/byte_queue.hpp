@@ -0,0 +1,25 @@
+#pragma once
+
+namespace demonware
+{
+	class byte_queue final
+	{
+	public:
+		byte_queue() = default;
+
+		void push(std::string data);
+
+		size_t read(void* output, size_t length);
+		size_t gather(std::vector<std::string_view>* output, size_t length = SIZE_MAX) const;
+		void consume(size_t length);
+
+		size_t size() const;
+		bool empty() const;
+		void clear();
+
+	private:
+		std::deque<std::string> chunks_;
+		size_t offset_ = 0;
+		size_t size_ = 0;
+	};
+}
@@ -0,0 +1,214 @@
+#include <std_include.hpp>
+#include "byte_view.hpp"
+
+namespace demonware
+{
+	bool byte_view::read_byte(unsigned char* output)
+	{
+		if (!this->read_data_type(3)) return false;
+		return this->read(1, output);
+	}
+
+	bool byte_view::read_bool(bool* output)
+	{
+		if (!this->read_data_type(1)) return false;
+		return this->read(1, output);
+	}
+
+	bool byte_view::read_int16(short* output)
+	{
+		if (!this->read_data_type(5)) return false;
+		return this->read(2, output);
+	}
+
+	bool byte_view::read_uint16(unsigned short* output)
+	{
+		if (!this->read_data_type(6)) return false;
+		return this->read(2, output);
+	}
+
+	bool byte_view::read_int32(int* output)
+	{
+		if (!this->read_data_type(7)) return false;
+		return this->read(4, output);
+	}
+
+	bool byte_view::read_uint32(unsigned int* output)
+	{
+		if (!this->read_data_type(8)) return false;
+		return this->read(4, output);
+	}
+
+	bool byte_view::read_int64(__int64* output)
+	{
+		if (!this->read_data_type(9)) return false;
+		return this->read(8, output);
+	}
+
+	bool byte_view::read_uint64(unsigned __int64* output)
+	{
+		if (!this->read_data_type(10)) return false;
+		return this->read(8, output);
+	}
+
+	bool byte_view::read_float(float* output)
+	{
+		if (!this->read_data_type(13)) return false;
+		return this->read(4, output);
+	}
+
+	bool byte_view::read_string(std::string_view* output)
+	{
+		if (!this->read_data_type(16)) return false;
+
+		const auto remaining = this->get_remaining();
+		const auto length = remaining.find('\0');
+		if (length == std::string_view::npos) return false;
+
+		*output = remaining.substr(0, length);
+		this->current_byte_ += length + 1;
+
+		return true;
+	}
+
+	bool byte_view::read_string(std::string* output)
+	{
+		std::string_view out_data;
+		if (this->read_string(&out_data))
+		{
+			output->assign(out_data);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool byte_view::read_string(char* output, const int length)
+	{
+		std::string_view out_data;
+		if (!this->read_string(&out_data)) return false;
+
+		strncpy_s(output, length, out_data.data(), _TRUNCATE);
+		return true;
+	}
+
+	bool byte_view::read_blob(std::string_view* output)
+	{
+		if (!this->read_data_type(0x13))
+		{
+			return false;
+		}
+
+		unsigned int size;
+		if (!this->read_uint32(&size)) return false;
+		if (size > this->data_.size() - this->current_byte_) return false;
+
+		*output = this->data_.substr(this->current_byte_, size);
+		this->current_byte_ += size;
+
+		return true;
+	}
+
+	bool byte_view::read_blob(std::string* output)
+	{
+		std::string_view out_data;
+		if (this->read_blob(&out_data))
+		{
+			output->assign(out_data);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool byte_view::read_blob(const char** output, int* length)
+	{
+		std::string_view out_data;
+		if (!this->read_blob(&out_data)) return false;
+
+		*output = out_data.data();
+		*length = static_cast<int>(out_data.size());
+
+		return true;
+	}
+
+	bool byte_view::read_data_type(const char expected)
+	{
+		if (!this->use_data_types_) return true;
+
+		char type;
+		if (!this->read(1, &type)) return false;
+		return type == expected;
+	}
+
+	bool byte_view::read_array_header(const unsigned char expected, unsigned int* element_count,
+	                                  unsigned int* element_size)
+	{
+		if (element_count) *element_count = 0;
+		if (element_size) *element_size = 0;
+
+		if (!this->read_data_type(expected + 100)) return false;
+
+		uint32_t array_size, el_count;
+		if (!this->read_uint32(&array_size)) return false;
+
+		this->set_use_data_types(false);
+		const auto result = this->read_uint32(&el_count);
+		this->set_use_data_types(true);
+
+		if (!result || !el_count) return false;
+
+		if (element_count) *element_count = el_count;
+		if (element_size) *element_size = array_size / el_count;
+
+		return true;
+	}
+
+	bool byte_view::read(const int bytes, void* output)
+	{
+		if (bytes < 0 || bytes + this->current_byte_ > this->data_.size()) return false;
+
+		std::memcpy(output, this->data_.data() + this->current_byte_, bytes);
+		this->current_byte_ += bytes;
+
+		return true;
+	}
+
+	bool byte_view::skip(const int bytes)
+	{
+		if (bytes < 0 || bytes + this->current_byte_ > this->data_.size()) return false;
+
+		this->current_byte_ += bytes;
+		return true;
+	}
+
+	void byte_view::set_use_data_types(const bool use_data_types)
+	{
+		this->use_data_types_ = use_data_types;
+	}
+
+	size_t byte_view::size() const
+	{
+		return this->data_.size();
+	}
+
+	bool byte_view::is_using_data_types() const
+	{
+		return this->use_data_types_;
+	}
+
+	std::string_view byte_view::get_data() const
+	{
+		return this->data_;
+	}
+
+	std::string_view byte_view::get_remaining() const
+	{
+		return this->data_.substr(this->current_byte_);
+	}
+
+	bool byte_view::has_more_data() const
+	{
+		return this->data_.size() > this->current_byte_;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+namespace demonware
+{
+	// Non-owning counterpart of byte_buffer for reading.
+	// The viewed data has to outlive the view.
+	class byte_view final
+	{
+	public:
+		byte_view() = default;
+
+		explicit byte_view(const std::string_view& data) : data_(data)
+		{
+		}
+
+		bool read_byte(unsigned char* output);
+		bool read_bool(bool* output);
+		bool read_int16(short* output);
+		bool read_uint16(unsigned short* output);
+		bool read_int32(int* output);
+		bool read_uint32(unsigned int* output);
+		bool read_int64(__int64* output);
+		bool read_uint64(unsigned __int64* output);
+		bool read_float(float* output);
+		bool read_string(std::string_view* output);
+		bool read_string(char* output, int length);
+		bool read_string(std::string* output);
+		bool read_blob(const char** output, int* length);
+		bool read_blob(std::string_view* output);
+		bool read_blob(std::string* output);
+		bool read_data_type(char expected);
+
+		bool read_array_header(unsigned char expected, unsigned int* element_count,
+		                       unsigned int* element_size = nullptr);
+
+		bool read(int bytes, void* output);
+		bool skip(int bytes);
+
+		void set_use_data_types(bool use_data_types);
+		size_t size() const;
+
+		bool is_using_data_types() const;
+
+		std::string_view get_data() const;
+		std::string_view get_remaining() const;
+
+		bool has_more_data() const;
+
+	private:
+		std::string_view data_;
+		size_t current_byte_ = 0;
+		bool use_data_types_ = true;
+	};
+}
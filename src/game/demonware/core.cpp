@@ -0,0 +1,243 @@
+#include <std_include.hpp>
+#include "core.hpp"
+#include "utils/cryptography.hpp"
+#include "utils/string.hpp"
+
+#include "services/bdLSGHello.hpp"       // 7
+#include "services/bdStorage.hpp"        // 10
+#include "services/bdDediAuth.hpp"       // 12
+#include "services/bdTitleUtilities.hpp" // 12
+#include "services/bdDML.hpp"            // 27
+#include "services/bdDediRSAAuth.hpp"    // 26
+#include "services/bdSteamAuth.hpp"      // 28
+
+namespace demonware
+{
+	core* core::instance_ = nullptr;
+
+	core::core(const settings& settings)
+	{
+		assert(!instance_);
+		instance_ = this;
+
+		this->worker_pool_ = std::make_unique<utils::thread_pool>("DW Worker", settings.worker_count);
+		this->io_pool_ = std::make_unique<utils::thread_pool>("DW I/O", 1);
+		this->user_storage_ = std::make_unique<user_storage>(settings.storage_directory, settings.storage_cache_size,
+		                                                     settings.storage_flush_interval);
+		this->nat_ = std::make_unique<nat_simulator>(settings.nat_type, settings.nat_first_address);
+	}
+
+	core::~core()
+	{
+		// Workers can still hand storage requests to the I/O thread while draining
+		this->worker_pool_->stop();
+		this->io_pool_->stop();
+
+		// Writes everything still pending to disk
+		this->user_storage_.reset();
+
+		{
+			std::lock_guard _(this->server_mutex_);
+			this->servers_.clear();
+			this->stun_servers_.clear();
+		}
+
+		instance_ = nullptr;
+	}
+
+	core& core::get()
+	{
+		assert(instance_);
+		return *instance_;
+	}
+
+	std::shared_ptr<stun_server> core::register_stun_server(const std::string& name)
+	{
+		std::lock_guard _(this->server_mutex_);
+		auto server = std::make_shared<stun_server>(name, this->nat_.get());
+		this->stun_servers_[server->get_address()] = server;
+		return server;
+	}
+
+	void core::register_default_servers()
+	{
+		this->register_stun_server("mw3-stun.us.demonware.net");
+		this->register_stun_server("mw3-stun.eu.demonware.net");
+		this->register_stun_server("stun.jp.demonware.net");
+		this->register_stun_server("stun.au.demonware.net");
+		this->register_stun_server("stun.eu.demonware.net");
+		this->register_stun_server("stun.us.demonware.net");
+
+		auto lsg_server = this->register_server("mw3-pc-lobby.prod.demonware.net");
+		auto auth_server = this->register_server("mw3-pc-auth.prod.demonware.net");
+
+		auth_server->register_service<bdDediAuth>();
+		auth_server->register_service<bdSteamAuth>();
+		auth_server->register_service<bdDediRSAAuth>();
+
+		lsg_server->register_service<bdLSGHello>();
+		lsg_server->register_service<bdStorage>();
+		lsg_server->register_service<bdTitleUtilities>();
+		lsg_server->register_service<bdDML>();
+		/*lsg_server->register_service<bdMatchMaking>();
+		lsg_server->register_service<bdBandwidthTest>();
+		lsg_server->register_service<bdGroup>();
+		lsg_server->register_service<bdAnticheat>();
+		lsg_server->register_service<bdRelayService>();*/
+	}
+
+	std::shared_ptr<stun_server> core::find_stun_server_by_name(const std::string& name) const
+	{
+		return this->find_stun_server_by_address(utils::cryptography::jenkins_one_at_a_time::compute(name));
+	}
+
+	std::shared_ptr<stun_server> core::find_stun_server_by_address(const unsigned long address) const
+	{
+		std::shared_lock _(this->server_mutex_);
+
+		const auto server = this->stun_servers_.find(address);
+		if (server != this->stun_servers_.end())
+		{
+			return server->second;
+		}
+
+		return {};
+	}
+
+	std::shared_ptr<service_server> core::find_server_by_name(const std::string& name) const
+	{
+		return this->find_server_by_address(utils::cryptography::jenkins_one_at_a_time::compute(name));
+	}
+
+	std::shared_ptr<service_server> core::find_server_by_address(const unsigned long address) const
+	{
+		std::shared_lock _(this->server_mutex_);
+
+		const auto server = this->servers_.find(address);
+		if (server != this->servers_.end())
+		{
+			return server->second;
+		}
+
+		return {};
+	}
+
+	std::vector<std::shared_ptr<service_server>> core::get_servers() const
+	{
+		std::shared_lock _(this->server_mutex_);
+
+		std::vector<std::shared_ptr<service_server>> servers;
+		servers.reserve(this->servers_.size());
+
+		for (const auto& server : this->servers_)
+		{
+			servers.push_back(server.second);
+		}
+
+		return servers;
+	}
+
+	std::vector<std::shared_ptr<stun_server>> core::get_stun_servers() const
+	{
+		std::shared_lock _(this->server_mutex_);
+
+		std::vector<std::shared_ptr<stun_server>> servers;
+		servers.reserve(this->stun_servers_.size());
+
+		for (const auto& server : this->stun_servers_)
+		{
+			servers.push_back(server.second);
+		}
+
+		return servers;
+	}
+
+	void core::schedule(const std::shared_ptr<service_session>& session)
+	{
+		// Sessions are queued when their data arrives instead of being polled,
+		// so the cost doesn't grow with the number of idle connections
+		if (!session->has_pending_data() || !session->schedule()) return;
+
+		this->worker_pool_->submit([session]()
+		{
+			session->run_frame();
+		});
+	}
+
+	void core::submit_io(std::function<void()> work)
+	{
+		// Disk access is serialized on its own thread so slow storage
+		// never stalls the workers handling other services
+		this->io_pool_->submit([this, work = std::move(work)]()
+		{
+			const auto latency = this->io_latency_.load();
+			if (latency > 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+			}
+
+			work();
+		});
+	}
+
+	int core::get_io_latency() const
+	{
+		return this->io_latency_;
+	}
+
+	void core::set_io_latency(const int latency)
+	{
+		this->io_latency_ = std::max(0, latency);
+	}
+
+	user_storage& core::get_user_storage()
+	{
+		return *this->user_storage_;
+	}
+
+	nat_simulator& core::get_nat()
+	{
+		return *this->nat_;
+	}
+
+	void core::dump_statistics(const std::function<void(const char*)>& print)
+	{
+		const auto storage = this->user_storage_->get_statistics();
+		const auto lookups = storage.hits + storage.misses;
+
+		print(utils::string::va("DW storage: %zu files indexed, %zu cached (%zu bytes), hit rate %.1f%% (%llu/%llu), %zu dirty files (%zu bytes)\n",
+		                        storage.indexed_files, storage.files, storage.cached_bytes,
+		                        lookups ? 100.0 * storage.hits / lookups : 0.0, storage.hits, lookups,
+		                        storage.dirty_files, storage.dirty_bytes));
+		print(utils::string::va("DW storage: %llu bytes in %zu blobs on disk for %llu bytes of user files\n",
+		                        storage.blob_bytes, storage.blobs, storage.indexed_bytes));
+		print(utils::string::va("DW NAT: %s, %zu mapped clients\n", nat_simulator::get_type_name(this->nat_->get_type()),
+		                        this->nat_->get_client_count()));
+
+		for (const auto& server : this->get_servers())
+		{
+			const auto stats = server->get_statistics();
+			const auto average_wait = stats.packets_handled
+				                          ? stats.total_queue_wait.count() / static_cast<int64_t>(stats.packets_handled)
+				                          : 0;
+
+			print(utils::string::va("DW server %s: %llu packets, queue depth %zu (max %zu), queue wait avg %lld us (max %lld us)\n",
+			                        server->get_name().data(), stats.packets_handled, stats.queue_depth,
+			                        stats.max_queue_depth, average_wait, stats.max_queue_wait.count()));
+
+			for (auto type = 0; type < 256; ++type)
+			{
+				const auto* service = server->get_service(static_cast<uint8_t>(type));
+				if (!service) continue;
+
+				print(utils::string::va("  service %d: %llu calls\n", type, server->get_call_count(static_cast<uint8_t>(type))));
+
+				for (auto sub_type = 0; sub_type < 256; ++sub_type)
+				{
+					const auto calls = service->get_call_count(static_cast<uint8_t>(sub_type));
+					if (calls) print(utils::string::va("    subtype %d: %llu calls\n", sub_type, calls));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <utils/thread_pool.hpp>
+
+#include "stun_server.hpp"
+#include "service_server.hpp"
+#include "service_session.hpp"
+#include "user_storage.hpp"
+
+namespace demonware
+{
+	// The emulated backend, independent of how clients reach it.
+	// The game module feeds it through hooked Winsock calls, dw-server through real sockets.
+	class core final
+	{
+	public:
+		struct settings
+		{
+			size_t worker_count = 4;
+			std::string storage_directory = "players2/user";
+			size_t storage_cache_size = 64 * 1024 * 1024;
+			std::chrono::milliseconds storage_flush_interval = 5s;
+
+			nat_simulator::type nat_type = nat_simulator::type::none;
+			unsigned long nat_first_address = 0x0A000001; // 10.0.0.1
+		};
+
+		explicit core(const settings& settings);
+		~core();
+
+		core(core&&) = delete;
+		core(const core&) = delete;
+		core& operator=(core&&) = delete;
+		core& operator=(const core&) = delete;
+
+		// Only one backend runs per process, services reach it through here
+		static core& get();
+
+		template <typename... Args>
+		std::shared_ptr<service_server> register_server(Args ... args)
+		{
+			std::lock_guard _(this->server_mutex_);
+			auto server = std::make_shared<service_server>(args...);
+			this->servers_[server->get_address()] = server;
+			return server;
+		}
+
+		std::shared_ptr<stun_server> register_stun_server(const std::string& name);
+
+		// The servers and services the game expects to find
+		void register_default_servers();
+
+		std::shared_ptr<stun_server> find_stun_server_by_name(const std::string& name) const;
+		std::shared_ptr<stun_server> find_stun_server_by_address(unsigned long address) const;
+
+		std::shared_ptr<service_server> find_server_by_name(const std::string& name) const;
+		std::shared_ptr<service_server> find_server_by_address(unsigned long address) const;
+
+		std::vector<std::shared_ptr<service_server>> get_servers() const;
+		std::vector<std::shared_ptr<stun_server>> get_stun_servers() const;
+
+		// Queues a frame for the session if it has work and none is queued yet
+		void schedule(const std::shared_ptr<service_session>& session);
+		void submit_io(std::function<void()> work);
+
+		int get_io_latency() const;
+		void set_io_latency(int latency);
+
+		user_storage& get_user_storage();
+		nat_simulator& get_nat();
+
+		void dump_statistics(const std::function<void(const char*)>& print);
+
+	private:
+		static core* instance_;
+
+		// Outlives the STUN servers pointing to it
+		std::unique_ptr<nat_simulator> nat_;
+
+		mutable std::shared_mutex server_mutex_;
+		std::map<unsigned long, std::shared_ptr<service_server>> servers_;
+		std::map<unsigned long, std::shared_ptr<stun_server>> stun_servers_;
+
+		std::unique_ptr<utils::thread_pool> worker_pool_;
+		std::unique_ptr<utils::thread_pool> io_pool_;
+		std::atomic<int> io_latency_{0};
+		std::unique_ptr<user_storage> user_storage_;
+	};
+}
@@ -0,0 +1,51 @@
+#include <std_include.hpp>
+#include "crypto_session.hpp"
+
+namespace demonware
+{
+	crypto_session::crypto_session()
+	{
+		const uint8_t key[24]{};
+		this->set_key(true, key);
+		this->set_key(false, key);
+
+		this->get_iv(reply_seed);
+	}
+
+	void crypto_session::set_key(const bool encrypt, const uint8_t* key)
+	{
+		std::unique_lock _(this->key_mutex_);
+		(encrypt ? this->encryption_context_ : this->decryption_context_).set_key(key, 24);
+	}
+
+	void crypto_session::encrypt(const int seed, const uint8_t* input, uint8_t* output, const size_t length) const
+	{
+		const auto iv = this->get_iv(seed);
+
+		std::shared_lock _(this->key_mutex_);
+		this->encryption_context_.encrypt(iv, input, output, length);
+	}
+
+	void crypto_session::decrypt(const int seed, const uint8_t* input, uint8_t* output, const size_t length) const
+	{
+		const auto iv = this->get_iv(seed);
+
+		std::shared_lock _(this->key_mutex_);
+		this->decryption_context_.decrypt(iv, input, output, length);
+	}
+
+	std::string crypto_session::get_iv(const int seed) const
+	{
+		std::lock_guard _(this->iv_mutex_);
+
+		auto& entry = this->iv_cache_[static_cast<uint32_t>(seed) % this->iv_cache_.size()];
+		if (!entry.valid || entry.seed != seed)
+		{
+			entry.valid = true;
+			entry.seed = seed;
+			entry.hash = utils::cryptography::tiger::compute(reinterpret_cast<const uint8_t*>(&seed), sizeof(seed));
+		}
+
+		return entry.hash;
+	}
+}
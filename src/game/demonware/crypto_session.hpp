@@ -0,0 +1,35 @@
+#pragma once
+#include "utils/cryptography.hpp"
+
+namespace demonware
+{
+	class crypto_session final
+	{
+	public:
+		static constexpr int reply_seed = 0x13371337;
+
+		crypto_session();
+
+		void set_key(bool encrypt, const uint8_t* key);
+
+		void encrypt(int seed, const uint8_t* input, uint8_t* output, size_t length) const;
+		void decrypt(int seed, const uint8_t* input, uint8_t* output, size_t length) const;
+
+	private:
+		struct iv_entry
+		{
+			bool valid;
+			int seed;
+			std::string hash;
+		};
+
+		mutable std::shared_mutex key_mutex_;
+		utils::cryptography::des3::context encryption_context_;
+		utils::cryptography::des3::context decryption_context_;
+
+		mutable std::mutex iv_mutex_;
+		mutable std::array<iv_entry, 16> iv_cache_{};
+
+		std::string get_iv(int seed) const;
+	};
+}
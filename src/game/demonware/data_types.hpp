@@ -1,10 +1,11 @@
 #pragma once
 #include "i_server.hpp"
+#include "schema.hpp"
 #include "game/structs.hpp"
 
 namespace demonware
 {
-	class bdFileData final : public i_serializable
+	class bdFileData final : public schema::serializable<bdFileData, i_serializable>
 	{
 	public:
 		std::string file_data;
@@ -13,18 +14,11 @@ namespace demonware
 		{
 		}
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_blob(this->file_data);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_blob(&this->file_data);
-		}
+		using fields = schema::fields<
+			schema::blob<&bdFileData::file_data>>;
 	};
 
-	class bdFileInfo final : public i_serializable
+	class bdFileInfo final : public schema::serializable<bdFileInfo, i_serializable>
 	{
 	public:
 		uint64_t file_id;
@@ -35,30 +29,17 @@ namespace demonware
 		std::string filename;
 		uint32_t file_size;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint32(this->file_size);
-			buffer->write_uint64(this->file_id);
-			buffer->write_uint32(this->create_time);
-			buffer->write_uint32(this->modified_time);
-			buffer->write_bool(this->priv);
-			buffer->write_uint64(this->owner_id);
-			buffer->write_string(this->filename);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint32(&this->file_size);
-			buffer->read_uint64(&this->file_id);
-			buffer->read_uint32(&this->create_time);
-			buffer->read_uint32(&this->modified_time);
-			buffer->read_bool(&this->priv);
-			buffer->read_uint64(&this->owner_id);
-			buffer->read_string(&this->filename);
-		}
+		using fields = schema::fields<
+			schema::field<&bdFileInfo::file_size>,
+			schema::field<&bdFileInfo::file_id>,
+			schema::field<&bdFileInfo::create_time>,
+			schema::field<&bdFileInfo::modified_time>,
+			schema::field<&bdFileInfo::priv>,
+			schema::field<&bdFileInfo::owner_id>,
+			schema::field<&bdFileInfo::filename>>;
 	};
 
-	class bdGroupCount final : public i_serializable
+	class bdGroupCount final : public schema::serializable<bdGroupCount, i_serializable>
 	{
 	public:
 		uint32_t group_id;
@@ -70,36 +51,21 @@ namespace demonware
 			this->group_count = 0;
 		}
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint32(this->group_id);
-			buffer->write_uint32(this->group_count);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint32(&this->group_id);
-			buffer->read_uint32(&this->group_count);
-		}
+		using fields = schema::fields<
+			schema::field<&bdGroupCount::group_id>,
+			schema::field<&bdGroupCount::group_count>>;
 	};
 
-	class bdTimeStamp final : public i_serializable
+	class bdTimeStamp final : public schema::serializable<bdTimeStamp, i_serializable>
 	{
 	public:
 		uint32_t unix_time;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint32(this->unix_time);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint32(&this->unix_time);
-		}
+		using fields = schema::fields<
+			schema::field<&bdTimeStamp::unix_time>>;
 	};
 
-	class bdDMLInfo : public i_serializable
+	class bdDMLInfo : public schema::serializable<bdDMLInfo, i_serializable>
 	{
 	public:
 		std::string country_code; // Char [3]
@@ -109,48 +75,25 @@ namespace demonware
 		float latitude;
 		float longitude;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_string(this->country_code);
-			buffer->write_string(this->country);
-			buffer->write_string(this->region);
-			buffer->write_string(this->city);
-			buffer->write_float(this->latitude);
-			buffer->write_float(this->longitude);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_string(&this->country_code);
-			buffer->read_string(&this->country);
-			buffer->read_string(&this->region);
-			buffer->read_string(&this->city);
-			buffer->read_float(&this->latitude);
-			buffer->read_float(&this->longitude);
-		}
+		using fields = schema::fields<
+			schema::field<&bdDMLInfo::country_code>,
+			schema::field<&bdDMLInfo::country>,
+			schema::field<&bdDMLInfo::region>,
+			schema::field<&bdDMLInfo::city>,
+			schema::field<&bdDMLInfo::latitude>,
+			schema::field<&bdDMLInfo::longitude>>;
 	};
 
-	class bdDMLRawData final : public bdDMLInfo
+	class bdDMLRawData final : public schema::serializable<bdDMLRawData, bdDMLInfo>
 	{
 	public:
 		uint32_t asn; // Autonomous System Number.
 		std::string timezone;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			bdDMLInfo::serialize(buffer);
-
-			buffer->write_uint32(this->asn);
-			buffer->write_string(this->timezone);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			bdDMLInfo::deserialize(buffer);
-
-			buffer->read_uint32(&this->asn);
-			buffer->read_string(&this->timezone);
-		}
+		using fields = schema::fields<
+			schema::base<bdDMLInfo>,
+			schema::field<&bdDMLRawData::asn>,
+			schema::field<&bdDMLRawData::timezone>>;
 	};
 
 	class bdSessionID final : public i_serializable
@@ -207,9 +150,17 @@ namespace demonware
 
 			if (this->symmetric) buffer->read_uint32(&this->num_players);
 		}
+
+		// What serialize writes, lets derived described types reserve their full size
+		size_t get_size(const bool data_types) const
+		{
+			return schema::blob_codec::size(this->host_addr, data_types)
+				+ sizeof(this->session_id.session_id) + sizeof(uint32_t) + (data_types ? 2 : 0)
+				+ 3 * schema::codec<uint32_t>::size(0, data_types);
+		}
 	};
 
-	class MatchMakingInfo final : public bdMatchmakingInfo
+	class MatchMakingInfo final : public schema::serializable<MatchMakingInfo, bdMatchmakingInfo>
 	{
 	public:
 		int32_t playlist_number;
@@ -229,68 +180,35 @@ namespace demonware
 		uint32_t data_centres;
 		uint32_t coop_state;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			bdMatchmakingInfo::serialize(buffer);
-
-			buffer->write_int32(this->playlist_number);
-			buffer->write_int32(this->playlist_version);
-			buffer->write_int32(this->netcode_version);
-			buffer->write_int32(this->map_packs);
-			buffer->write_int32(this->slots_needed_on_team);
-			buffer->write_int32(this->skill);
-			buffer->write_uint32(this->country_code);
-			buffer->write_uint32(this->asn);
-			buffer->write_float(this->latitude);
-			buffer->write_float(this->longitude);
-			buffer->write_int32(this->max_reserved_slots);
-			buffer->write_int32(this->used_reserved_slots);
-			buffer->write_blob(this->game_security_key);
-			buffer->write_blob(this->platform_session_id);
-			buffer->write_uint32(this->data_centres);
-			buffer->write_uint32(this->coop_state);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			bdMatchmakingInfo::deserialize(buffer);
-
-			buffer->read_int32(&this->playlist_number);
-			buffer->read_int32(&this->playlist_version);
-			buffer->read_int32(&this->netcode_version);
-			buffer->read_int32(&this->map_packs);
-			buffer->read_int32(&this->slots_needed_on_team);
-			buffer->read_int32(&this->skill);
-			buffer->read_uint32(&this->country_code);
-			buffer->read_uint32(&this->asn);
-			buffer->read_float(&this->latitude);
-			buffer->read_float(&this->longitude);
-			buffer->read_int32(&this->max_reserved_slots);
-			buffer->read_int32(&this->used_reserved_slots);
-			buffer->read_blob(&this->game_security_key);
-			buffer->read_blob(&this->platform_session_id);
-			buffer->read_uint32(&this->data_centres);
-			buffer->read_uint32(&this->coop_state);
-		}
+		using fields = schema::fields<
+			schema::base<bdMatchmakingInfo>,
+			schema::field<&MatchMakingInfo::playlist_number>,
+			schema::field<&MatchMakingInfo::playlist_version>,
+			schema::field<&MatchMakingInfo::netcode_version>,
+			schema::field<&MatchMakingInfo::map_packs>,
+			schema::field<&MatchMakingInfo::slots_needed_on_team>,
+			schema::field<&MatchMakingInfo::skill>,
+			schema::field<&MatchMakingInfo::country_code>,
+			schema::field<&MatchMakingInfo::asn>,
+			schema::field<&MatchMakingInfo::latitude>,
+			schema::field<&MatchMakingInfo::longitude>,
+			schema::field<&MatchMakingInfo::max_reserved_slots>,
+			schema::field<&MatchMakingInfo::used_reserved_slots>,
+			schema::blob<&MatchMakingInfo::game_security_key>,
+			schema::blob<&MatchMakingInfo::platform_session_id>,
+			schema::field<&MatchMakingInfo::data_centres>,
+			schema::field<&MatchMakingInfo::coop_state>>;
 	};
 
-	class bdPerformanceValue final : public i_serializable
+	class bdPerformanceValue final : public schema::serializable<bdPerformanceValue, i_serializable>
 	{
 	public:
 		uint64_t user_id;
 		int64_t performance;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint64(this->user_id);
-			buffer->write_int64(this->performance);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint64(&this->user_id);
-			buffer->read_int64(&this->performance);
-		}
+		using fields = schema::fields<
+			schema::field<&bdPerformanceValue::user_id>,
+			schema::field<&bdPerformanceValue::performance>>;
 	};
 
 	struct bdSockAddr final
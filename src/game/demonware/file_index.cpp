@@ -0,0 +1,281 @@
+#include <std_include.hpp>
+#include "file_index.hpp"
+#include "byte_buffer.hpp"
+#include "byte_view.hpp"
+
+namespace demonware
+{
+	const file_index::file_info* file_index::find(const std::string& id) const
+	{
+		const auto entry = this->files_.find(id);
+		if (entry == this->files_.end()) return nullptr;
+		return &entry->second;
+	}
+
+	void file_index::update(const std::string& id, const file_info& info)
+	{
+		auto entry = this->files_.find(id);
+		if (entry != this->files_.end())
+		{
+			this->unlink(&*entry);
+			entry->second = info;
+		}
+		else
+		{
+			entry = this->files_.emplace(id, info).first;
+		}
+
+		this->link(&*entry);
+	}
+
+	void file_index::set_hash(const std::string& id, const std::string& hash)
+	{
+		const auto entry = this->files_.find(id);
+		if (entry != this->files_.end())
+		{
+			entry->second.hash = hash;
+		}
+	}
+
+	void file_index::assign(std::vector<std::pair<std::string, file_info>> files)
+	{
+		this->clear();
+		this->files_.reserve(files.size());
+
+		for (auto& file : files)
+		{
+			this->files_[std::move(file.first)] = std::move(file.second);
+		}
+
+		this->link_all();
+	}
+
+	std::vector<file_index::file_info> file_index::list(const query& query) const
+	{
+		using range = std::pair<std::vector<const file_entry*>::const_iterator,
+		                        std::vector<const file_entry*>::const_iterator>;
+
+		std::vector<range> ranges;
+		const auto add_owner = [this, &query, &ranges](const uint64_t id)
+		{
+			const auto owner = this->owners_.find(id);
+			if (owner == this->owners_.end()) return;
+
+			const auto& files = owner->second;
+			const auto file = std::lower_bound(files.begin(), files.end(), query.prefix,
+			                                   [](const file_entry* entry, const std::string& prefix)
+			                                   {
+				                                   return entry->second.filename < prefix;
+			                                   });
+
+			if (file != files.end()) ranges.emplace_back(file, files.end());
+		};
+
+		add_owner(query.owner);
+		if (query.include_unowned && query.owner != 0) add_owner(0);
+
+		size_t skipped = 0;
+
+		// All names sharing the prefix are adjacent, so without further filters
+		// the offset can be applied directly
+		if (!query.pattern && !query.min_modified_time)
+		{
+			for (auto& files : ranges)
+			{
+				files.second = std::partition_point(files.first, files.second, [&query](const file_entry* entry)
+				{
+					return entry->second.filename.starts_with(query.prefix);
+				});
+			}
+
+			if (ranges.size() == 1)
+			{
+				auto& files = ranges.front();
+				files.first += std::min(query.offset, size_t(files.second - files.first));
+			}
+			else if (ranges.size() == 2)
+			{
+				// Binary search for how many of the skipped files come from the first owner
+				auto& a = ranges[0];
+				auto& b = ranges[1];
+
+				const auto a_size = size_t(a.second - a.first);
+				const auto b_size = size_t(b.second - b.first);
+				const auto count = std::min(query.offset, a_size + b_size);
+
+				auto low = count > b_size ? count - b_size : 0;
+				auto high = std::min(count, a_size);
+
+				while (low < high)
+				{
+					const auto middle = (low + high) / 2;
+					if (compare(*(a.first + middle), *(b.first + (count - middle - 1)))) low = middle + 1;
+					else high = middle;
+				}
+
+				a.first += low;
+				b.first += count - low;
+			}
+
+			skipped = query.offset;
+		}
+
+		std::vector<file_info> result;
+		const auto limit = query.num_results ? query.num_results : SIZE_MAX;
+
+		while (result.size() < limit)
+		{
+			// Owners are merged by name, so every page is cut from the same order
+			range* next = nullptr;
+			for (auto& files : ranges)
+			{
+				if (files.first == files.second || !(*files.first)->second.filename.starts_with(query.prefix)) continue;
+				if (!next || compare(*files.first, *next->first)) next = &files;
+			}
+
+			if (!next) break;
+
+			const auto& info = (*next->first++)->second;
+			if (query.pattern && !std::regex_match(info.filename, *query.pattern)) continue;
+			if (info.modified_time < query.min_modified_time) continue;
+
+			if (skipped < query.offset)
+			{
+				++skipped;
+				continue;
+			}
+
+			result.push_back(info);
+		}
+
+		return result;
+	}
+
+	size_t file_index::size() const
+	{
+		return this->files_.size();
+	}
+
+	void file_index::clear()
+	{
+		this->owners_.clear();
+		this->files_.clear();
+	}
+
+	std::string file_index::serialize() const
+	{
+		byte_buffer buffer(this->files_.size() * 64 + 12);
+		buffer.set_use_data_types(false);
+
+		buffer.write_uint32(magic);
+		buffer.write_uint32(version);
+		buffer.write_uint32(uint32_t(this->files_.size()));
+
+		for (const auto& file : this->files_)
+		{
+			buffer.write_string(file.first);
+			buffer.write_uint64(file.second.file_id);
+			buffer.write_string(file.second.filename);
+			buffer.write_uint64(file.second.owner);
+			buffer.write_uint32(file.second.create_time);
+			buffer.write_uint32(file.second.modified_time);
+			buffer.write_uint32(file.second.size);
+			buffer.write_bool(file.second.priv);
+			buffer.write_string(file.second.hash);
+		}
+
+		return buffer.get_buffer();
+	}
+
+	bool file_index::deserialize(const std::string& data)
+	{
+		this->clear();
+
+		byte_view buffer(data);
+		buffer.set_use_data_types(false);
+
+		uint32_t file_magic, file_version, count;
+		if (!buffer.read_uint32(&file_magic) || file_magic != magic
+			|| !buffer.read_uint32(&file_version) || file_version < 1 || file_version > version
+			|| !buffer.read_uint32(&count))
+		{
+			return false;
+		}
+
+		this->files_.reserve(count);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			std::string id;
+			file_info info{};
+
+			if (!buffer.read_string(&id)
+				|| !buffer.read_uint64(&info.file_id)
+				|| !buffer.read_string(&info.filename)
+				|| !buffer.read_uint64(&info.owner)
+				|| !buffer.read_uint32(&info.create_time)
+				|| !buffer.read_uint32(&info.modified_time)
+				|| !buffer.read_uint32(&info.size)
+				|| !buffer.read_bool(&info.priv)
+				|| (file_version >= 2 && !buffer.read_string(&info.hash)))
+			{
+				this->clear();
+				return false;
+			}
+
+			this->files_[id] = std::move(info);
+		}
+
+		this->link_all();
+		return true;
+	}
+
+	bool file_index::compare(const file_entry* a, const file_entry* b)
+	{
+		if (a->second.filename != b->second.filename)
+		{
+			return a->second.filename < b->second.filename;
+		}
+
+		return a->first < b->first;
+	}
+
+	void file_index::link(const file_entry* entry)
+	{
+		auto& files = this->owners_[entry->second.owner];
+		files.insert(std::upper_bound(files.begin(), files.end(), entry, compare), entry);
+	}
+
+	void file_index::link_all()
+	{
+		this->owners_.clear();
+
+		for (const auto& entry : this->files_)
+		{
+			this->owners_[entry.second.owner].push_back(&entry);
+		}
+
+		for (auto& owner : this->owners_)
+		{
+			std::sort(owner.second.begin(), owner.second.end(), compare);
+		}
+	}
+
+	void file_index::unlink(const file_entry* entry)
+	{
+		const auto owner = this->owners_.find(entry->second.owner);
+		if (owner == this->owners_.end()) return;
+
+		auto& files = owner->second;
+		const auto file = std::lower_bound(files.begin(), files.end(), entry, compare);
+		if (file != files.end() && *file == entry)
+		{
+			files.erase(file);
+		}
+
+		if (files.empty())
+		{
+			this->owners_.erase(owner);
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+namespace demonware
+{
+	// Metadata of every stored user file, grouped by owner and sorted by filename.
+	// Not thread-safe, the owner is expected to serialize access.
+	class file_index final
+	{
+	public:
+		struct file_info
+		{
+			uint64_t file_id;
+			std::string filename;
+			uint64_t owner;
+			uint32_t create_time;
+			uint32_t modified_time;
+			uint32_t size;
+			bool priv;
+
+			// SHA-256 of the contents, empty for files still in the flat layout
+			std::string hash;
+		};
+
+		struct query
+		{
+			uint64_t owner;
+			// Also lists files stored without an owner, like legacy uploads
+			bool include_unowned;
+			std::string prefix;
+			const std::regex* pattern;
+			uint32_t min_modified_time;
+			size_t offset;
+			size_t num_results;
+		};
+
+		const file_info* find(const std::string& id) const;
+		void update(const std::string& id, const file_info& info);
+		void set_hash(const std::string& id, const std::string& hash);
+
+		// Replaces the whole index, cheaper than updating file by file
+		void assign(std::vector<std::pair<std::string, file_info>> files);
+
+		// For a single owner without a pattern or date cutoff this only touches the requested page
+		std::vector<file_info> list(const query& query) const;
+
+		size_t size() const;
+		void clear();
+
+		template <typename F>
+		void for_each(F&& callback) const
+		{
+			for (const auto& file : this->files_)
+			{
+				callback(file.first, file.second);
+			}
+		}
+
+		std::string serialize() const;
+		bool deserialize(const std::string& data);
+
+	private:
+		static constexpr uint32_t magic = 0x58444946;
+		static constexpr uint32_t version = 2;
+
+		using file_entry = std::pair<const std::string, file_info>;
+
+		std::unordered_map<std::string, file_info> files_;
+		std::unordered_map<uint64_t, std::vector<const file_entry*>> owners_;
+
+		static bool compare(const file_entry* a, const file_entry* b);
+
+		void link(const file_entry* entry);
+		void unlink(const file_entry* entry);
+
+		// Sorts every owner once instead of inserting file by file
+		void link_all();
+	};
+}
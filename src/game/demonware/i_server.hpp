@@ -1,6 +1,9 @@
 #pragma once
 #include "bit_buffer.hpp"
 #include "byte_buffer.hpp"
+#include "byte_view.hpp"
+#include "crypto_session.hpp"
+#include "reply_arena.hpp"
 
 namespace demonware
 {
@@ -20,9 +23,10 @@ namespace demonware
 		{
 		}
 
+		// Replies are only consumed once, so the data is handed over instead of copied
 		virtual std::string get_data() override
 		{
-			return this->buffer_;
+			return std::move(this->buffer_);
 		}
 
 	protected:
@@ -46,17 +50,27 @@ namespace demonware
 	class encrypted_reply final : public typed_reply
 	{
 	public:
-		encrypted_reply(const uint8_t type, bit_buffer* bbuffer) : typed_reply(type)
+		encrypted_reply(const uint8_t type, bit_buffer* bbuffer, const crypto_session& crypto) : typed_reply(type),
+			crypto_(&crypto)
 		{
 			this->buffer_.append(bbuffer->get_buffer());
 		}
 
-		encrypted_reply(const uint8_t type, byte_buffer* bbuffer) : typed_reply(type)
+		encrypted_reply(const uint8_t type, byte_buffer* bbuffer, const crypto_session& crypto) : typed_reply(type),
+			crypto_(&crypto)
 		{
 			this->buffer_.append(bbuffer->get_buffer());
 		}
 
 		virtual std::string get_data() override;
+
+		// Lets a payload be serialized straight into the frame:
+		// write_header, then the payload, then seal to pad and encrypt it in place
+		static void write_header(byte_buffer* buffer, uint8_t type);
+		static std::string seal(byte_buffer* buffer, const crypto_session& crypto);
+
+	private:
+		const crypto_session* crypto_;
 	};
 
 	class unencrypted_reply final : public typed_reply
@@ -87,6 +101,13 @@ namespace demonware
 
 		virtual void send_reply(reply* reply) = 0;
 
+		// Runs work off the service thread. Further messages on this
+		// connection are held back until the work has completed.
+		virtual void defer(std::function<void()> work) = 0;
+
+		// Keys are negotiated per connection
+		virtual crypto_session& get_crypto() = 0;
+
 		virtual std::shared_ptr<remote_reply> create_message(uint8_t type)
 		{
 			auto reply = std::make_shared<remote_reply>(this, type);
@@ -113,7 +134,7 @@ namespace demonware
 		{
 			std::unique_ptr<typed_reply> reply;
 
-			if (encrypted) reply = std::make_unique<encrypted_reply>(this->type_, buffer);
+			if (encrypted) reply = std::make_unique<encrypted_reply>(this->type_, buffer, this->server_->get_crypto());
 			else reply = std::make_unique<unencrypted_reply>(this->type_, buffer);
 			this->server_->send_reply(reply.get());
 		}
@@ -143,33 +164,37 @@ namespace demonware
 	{
 	public:
 		service_reply(i_server* _server, uint8_t _type, uint32_t _error) : type_(_type), error_(_error),
-		                                                                   reply_(_server, 1)
+		                                                                   server_(_server)
 		{
 		}
 
 		uint64_t send()
 		{
-			static uint64_t id = 0x8000000000000001;
+			static std::atomic<uint64_t> id = 0x8000000000000001;
 			const auto transaction_id = ++id;
 
-			byte_buffer buffer;
+			byte_buffer buffer(256);
+			encrypted_reply::write_header(&buffer, 1);
+
 			buffer.write_uint64(transaction_id);
 			buffer.write_uint32(this->error_);
 			buffer.write_byte(this->type_);
 
 			if (!this->error_)
 			{
-				buffer.write_uint32(uint32_t(this->objects_.size()));
-				if (!this->objects_.empty())
+				buffer.write_uint32(uint32_t(this->object_count_));
+				if (this->object_count_)
 				{
-					buffer.write_uint32(uint32_t(this->objects_.size()));
+					buffer.write_uint32(uint32_t(this->object_count_));
 
-					for (auto& object : this->objects_)
+					for (auto* entry = this->objects_; entry; entry = entry->next)
 					{
-						object->serialize(&buffer);
+						entry->serialize(entry->object, &buffer);
 					}
 
-					this->objects_.clear();
+					this->objects_ = nullptr;
+					this->last_object_ = nullptr;
+					this->object_count_ = 0;
 				}
 			}
 			else
@@ -177,25 +202,56 @@ namespace demonware
 				buffer.write_uint64(transaction_id);
 			}
 
-			this->reply_.send(&buffer, true);
+			raw_reply reply(encrypted_reply::seal(&buffer, this->server_->get_crypto()));
+			this->server_->send_reply(&reply);
 			return transaction_id;
 		}
 
-		void add(const std::shared_ptr<i_serializable>& object)
+		// Result objects live in the reply's arena and are destroyed with it
+		template <typename T, typename... Args>
+		T* create(Args&&... args)
 		{
-			this->objects_.push_back(object);
+			static_assert(std::is_base_of_v<i_serializable, T>, "Reply objects must be serializable");
+
+			auto* object = this->arena_.create<T>(std::forward<Args>(args)...);
+			// The concrete type is known here, so serialization skips the virtual call
+			auto* entry = this->arena_.create<object_entry>(object_entry{
+				object, [](i_serializable* data, byte_buffer* buffer)
+				{
+					static_cast<T*>(data)->T::serialize(buffer);
+				},
+				nullptr
+			});
+
+			if (this->last_object_) this->last_object_->next = entry;
+			else this->objects_ = entry;
+
+			this->last_object_ = entry;
+			++this->object_count_;
+
+			return object;
 		}
 
-		void add(i_serializable* object)
+		const reply_arena& get_arena() const
 		{
-			this->add(std::shared_ptr<i_serializable>(object));
+			return this->arena_;
 		}
 
 	private:
+		struct object_entry
+		{
+			i_serializable* object;
+			void (*serialize)(i_serializable*, byte_buffer*);
+			object_entry* next;
+		};
+
 		uint8_t type_;
 		uint32_t error_;
-		remote_reply reply_;
+		i_server* server_;
 
-		std::vector<std::shared_ptr<i_serializable>> objects_;
+		reply_arena arena_;
+		object_entry* objects_ = nullptr;
+		object_entry* last_object_ = nullptr;
+		size_t object_count_ = 0;
 	};
 }
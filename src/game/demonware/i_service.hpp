@@ -3,6 +3,31 @@
 
 namespace demonware
 {
+	// Everything a handler needs to know about the request it is handling.
+	// Handlers must not keep per-request state in the service itself,
+	// as the same service can handle multiple requests at once.
+	struct service_context final
+	{
+		i_server* server;
+		uint8_t type;
+		uint8_t sub_type;
+
+		std::shared_ptr<service_reply> create_reply(const uint32_t error = 0) const
+		{
+			return this->server->create_reply(this->sub_type, error);
+		}
+
+		// The reply for this request must be sent from within work
+		template <typename F>
+		void defer(F&& work) const
+		{
+			this->server->defer([context = *this, work = std::forward<F>(work)]()
+			{
+				work(context);
+			});
+		}
+	};
+
 	class i_service
 	{
 	public:
@@ -17,57 +42,73 @@ namespace demonware
 		i_service(const i_service&) = delete;
 		i_service& operator=(const i_service&) = delete;
 
-		typedef std::function<void(i_server*, byte_buffer*)> callback;
+		using callback = void(*)(i_service*, const service_context&, byte_view*);
 
 		virtual uint16_t getType() = 0;
 
-		virtual void call_service(i_server* server, const std::string& data)
+		virtual void call_service(i_server* server, const std::string_view& data)
 		{
-			std::lock_guard _(this->mutex_);
+			service_context context{server, static_cast<uint8_t>(this->getType()), 0};
 
-			byte_buffer buffer(data);
-			buffer.read_byte(&this->sub_type_);
+			byte_view buffer(data);
+			buffer.read_byte(&context.sub_type);
 
-			printf("DW: Handling subservice of type %d\n", this->sub_type_);
+			printf("DW: Handling subservice of type %d\n", context.sub_type);
 
-			const auto callback = this->callbacks_.find(this->sub_type_);
-			if (callback != this->callbacks_.end())
+			const auto callback = this->callbacks_[context.sub_type];
+			if (callback)
 			{
-				callback->second(server, &buffer);
+				++this->calls_[context.sub_type];
+				callback(this, context, &buffer);
 			}
 			else
 			{
-				printf("DW: Missing subservice %d for type %d\n", this->sub_type_, this->getType());
+				printf("DW: Missing subservice %d for type %d\n", context.sub_type, this->getType());
 			}
 		}
 
-	protected:
-		std::map<uint8_t, callback> callbacks_{};
-
-		template <typename Class, typename T, typename... Args>
-		void register_service(const uint8_t type, T (Class::*callback)(Args ...) const)
+		bool has_sub_service(const uint8_t sub_type) const
 		{
-			this->callbacks_[type] = [this, callback](Args ... args) -> T
-			{
-				return (reinterpret_cast<Class*>(this)->*callback)(args...);
-			};
+			return this->callbacks_[sub_type] != nullptr;
 		}
 
-		template <typename Class, typename T, typename... Args>
-		void register_service(const uint8_t type, T (Class::*callback)(Args ...))
+		uint64_t get_call_count(const uint8_t sub_type) const
 		{
-			this->callbacks_[type] = [this, callback](Args ... args) -> T
-			{
-				return (reinterpret_cast<Class*>(this)->*callback)(args...);
-			};
+			return this->calls_[sub_type];
 		}
 
-		uint8_t get_sub_type() const { return this->sub_type_; }
+	protected:
+		template <auto Callback>
+		void register_service(const uint8_t type)
+		{
+			this->callbacks_[type] = &invoke<Callback>;
+		}
 
 	private:
-		std::mutex mutex_;
+		template <typename T>
+		struct member_class;
+
+		template <typename Class, typename T, typename... Args>
+		struct member_class<T (Class::*)(Args ...)>
+		{
+			using type = Class;
+		};
+
+		template <typename Class, typename T, typename... Args>
+		struct member_class<T (Class::*)(Args ...) const>
+		{
+			using type = Class;
+		};
+
+		template <auto Callback>
+		static void invoke(i_service* service, const service_context& context, byte_view* buffer)
+		{
+			using class_type = typename member_class<decltype(Callback)>::type;
+			(static_cast<class_type*>(service)->*Callback)(context, buffer);
+		}
 
-		uint8_t sub_type_{};
+		std::array<callback, 256> callbacks_{};
+		std::array<std::atomic<uint64_t>, 256> calls_{};
 	};
 
 	template <uint16_t Type>
@@ -0,0 +1,165 @@
+#include <std_include.hpp>
+#include "nat_simulator.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		const char* const type_names[] = {"none", "open", "moderate", "strict"};
+
+		int64_t get_time()
+		{
+			return std::chrono::steady_clock::now().time_since_epoch().count();
+		}
+	}
+
+	nat_simulator::nat_simulator(const type type, const unsigned long first_address) : type_(type),
+	                                                                                    first_address_(first_address)
+	{
+		// The last address of the range is its broadcast address
+		this->max_clients_ = std::max(static_cast<uint32_t>(0xFFFF - (first_address & 0xFFFF)), 1u);
+	}
+
+	nat_simulator::type nat_simulator::get_type() const
+	{
+		return this->type_;
+	}
+
+	void nat_simulator::set_type(const type type)
+	{
+		this->type_ = type;
+	}
+
+	endpoint nat_simulator::map(const uint64_t client, const endpoint& source, const unsigned long destination)
+	{
+		const auto current = this->get_type();
+		if (current == type::none) return source;
+
+		endpoint result{};
+		result.address = htonl(this->first_address_ + this->get_index(client));
+		result.port = source.port;
+
+		if (current == type::strict)
+		{
+			// Symmetric NATs pick a fresh port for every destination
+			auto hash = static_cast<uint32_t>(client ^ (client >> 32)) * 0x9E3779B1u;
+			hash ^= static_cast<uint32_t>(destination) * 0x85EBCA6Bu;
+			hash ^= hash >> 15;
+
+			result.port = static_cast<uint16_t>(1024 + hash % (65536 - 1024));
+		}
+
+		return result;
+	}
+
+	void nat_simulator::release(const uint64_t client)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->clients_.find(client);
+		if (entry == this->clients_.end()) return;
+
+		this->free_indices_.push_back(entry->second.index);
+		this->clients_.erase(entry);
+	}
+
+	bool nat_simulator::accepts_unsolicited() const
+	{
+		const auto current = this->get_type();
+		return current == type::none || current == type::open;
+	}
+
+	size_t nat_simulator::get_client_count() const
+	{
+		std::shared_lock _(this->mutex_);
+		return this->clients_.size();
+	}
+
+	const char* nat_simulator::get_type_name(const type type)
+	{
+		return type_names[static_cast<size_t>(type)];
+	}
+
+	std::optional<nat_simulator::type> nat_simulator::parse_type(const std::string& name)
+	{
+		for (size_t i = 0; i < ARRAYSIZE(type_names); ++i)
+		{
+			if (name == type_names[i]) return static_cast<type>(i);
+		}
+
+		return {};
+	}
+
+	uint32_t nat_simulator::get_index(const uint64_t client)
+	{
+		{
+			std::shared_lock _(this->mutex_);
+
+			const auto entry = this->clients_.find(client);
+			if (entry != this->clients_.end())
+			{
+				entry->second.last_used = get_time();
+				return entry->second.index;
+			}
+		}
+
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->clients_.find(client);
+		if (entry != this->clients_.end())
+		{
+			entry->second.last_used = get_time();
+			return entry->second.index;
+		}
+
+		const auto index = this->allocate_index();
+
+		auto& created = this->clients_[client];
+		created.index = index;
+		created.last_used = get_time();
+
+		return index;
+	}
+
+	uint32_t nat_simulator::allocate_index()
+	{
+		if (this->free_indices_.empty())
+		{
+			if (this->next_index_ < this->max_clients_)
+			{
+				return this->next_index_++;
+			}
+
+			this->reclaim_indices();
+		}
+
+		// Released addresses are reused oldest first, so a reused socket
+		// doesn't immediately get the address its predecessor just had
+		const auto index = this->free_indices_.front();
+		this->free_indices_.pop_front();
+		return index;
+	}
+
+	void nat_simulator::reclaim_indices()
+	{
+		// Clients seen over the network never release their address. Once the range is
+		// used up, the quarter idle the longest give theirs back in one pass.
+		std::vector<std::pair<int64_t, uint64_t>> clients;
+		clients.reserve(this->clients_.size());
+
+		for (const auto& [client, entry] : this->clients_)
+		{
+			clients.emplace_back(entry.last_used.load(), client);
+		}
+
+		const auto count = std::max(clients.size() / 4, size_t(1));
+		std::nth_element(clients.begin(), clients.begin() + (count - 1), clients.end());
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto entry = this->clients_.find(clients[i].second);
+			this->free_indices_.push_back(entry->second.index);
+			this->clients_.erase(entry);
+		}
+	}
+}
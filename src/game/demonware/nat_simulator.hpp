@@ -0,0 +1,65 @@
+#pragma once
+
+namespace demonware
+{
+	// A transport address, the address in network byte order
+	struct endpoint
+	{
+		unsigned long address;
+		uint16_t port;
+	};
+
+	// Gives every virtual client its own synthetic public endpoint and
+	// decides which STUN answers get through the configured NAT type
+	class nat_simulator final
+	{
+	public:
+		enum class type
+		{
+			none, // Clients are reachable at the endpoint they send from
+			open, // Endpoint independent mapping and filtering
+			moderate, // Endpoint independent mapping, unsolicited packets are dropped
+			strict, // A new mapping per destination, unsolicited packets are dropped
+		};
+
+		// Synthetic addresses are handed out counting up from first_address (host byte order),
+		// staying inside its /16
+		nat_simulator(type type, unsigned long first_address);
+
+		type get_type() const;
+		void set_type(type type);
+
+		// The public endpoint the client's traffic towards destination appears to come from
+		endpoint map(uint64_t client, const endpoint& source, unsigned long destination);
+		void release(uint64_t client);
+
+		// Whether packets from an endpoint the client never sent to reach it
+		bool accepts_unsolicited() const;
+
+		size_t get_client_count() const;
+
+		static const char* get_type_name(type type);
+		static std::optional<type> parse_type(const std::string& name);
+
+	private:
+		std::atomic<type> type_;
+		unsigned long first_address_;
+
+		struct client_entry
+		{
+			uint32_t index;
+			std::atomic<int64_t> last_used;
+		};
+
+		uint32_t max_clients_;
+
+		mutable std::shared_mutex mutex_;
+		std::unordered_map<uint64_t, client_entry> clients_;
+		std::deque<uint32_t> free_indices_;
+		uint32_t next_index_ = 0;
+
+		uint32_t get_index(uint64_t client);
+		uint32_t allocate_index();
+		void reclaim_indices();
+	};
+}
@@ -0,0 +1,58 @@
+#include <std_include.hpp>
+#include "reply_arena.hpp"
+
+namespace demonware
+{
+	reply_arena::~reply_arena()
+	{
+		this->reset();
+	}
+
+	void* reply_arena::allocate(const size_t size, const size_t alignment)
+	{
+		auto space = this->remaining_;
+		void* pointer = this->current_;
+
+		if (!std::align(alignment, size, pointer, space))
+		{
+			// Oversized objects get a block of their own
+			const auto length = std::max(block_size, size + alignment);
+			this->blocks_.emplace_back(new std::byte[length]);
+
+			pointer = this->blocks_.back().get();
+			space = length;
+
+			std::align(alignment, size, pointer, space);
+		}
+
+		this->current_ = static_cast<std::byte*>(pointer) + size;
+		this->remaining_ = space - size;
+
+		return pointer;
+	}
+
+	void reply_arena::reset()
+	{
+		for (auto* entry = this->destructors_; entry; entry = entry->next)
+		{
+			entry->destroy(entry->object);
+		}
+
+		this->destructors_ = nullptr;
+		this->blocks_.clear();
+
+		this->current_ = this->inline_storage_;
+		this->remaining_ = inline_size;
+		this->allocations_ = 0;
+	}
+
+	size_t reply_arena::get_allocation_count() const
+	{
+		return this->allocations_;
+	}
+
+	size_t reply_arena::get_block_count() const
+	{
+		return this->blocks_.size();
+	}
+}
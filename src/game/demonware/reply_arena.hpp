@@ -0,0 +1,66 @@
+#pragma once
+
+namespace demonware
+{
+	// Bump allocator for the objects of a single reply.
+	// Small replies fit into the inline storage and never touch the heap.
+	class reply_arena final
+	{
+	public:
+		reply_arena() = default;
+		~reply_arena();
+
+		reply_arena(reply_arena&&) = delete;
+		reply_arena(const reply_arena&) = delete;
+		reply_arena& operator=(reply_arena&&) = delete;
+		reply_arena& operator=(const reply_arena&) = delete;
+
+		template <typename T, typename... Args>
+		T* create(Args&&... args)
+		{
+			auto* object = new(this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+			if constexpr (!std::is_trivially_destructible_v<T>)
+			{
+				auto* entry = new(this->allocate(sizeof(destructor), alignof(destructor))) destructor;
+				entry->object = object;
+				entry->destroy = [](void* data)
+				{
+					static_cast<T*>(data)->~T();
+				};
+
+				entry->next = this->destructors_;
+				this->destructors_ = entry;
+			}
+
+			++this->allocations_;
+			return object;
+		}
+
+		void* allocate(size_t size, size_t alignment);
+		void reset();
+
+		size_t get_allocation_count() const;
+		size_t get_block_count() const;
+
+	private:
+		static constexpr size_t inline_size = 512;
+		static constexpr size_t block_size = 4096;
+
+		struct destructor
+		{
+			void* object;
+			void (*destroy)(void*);
+			destructor* next;
+		};
+
+		alignas(std::max_align_t) std::byte inline_storage_[inline_size];
+		std::vector<std::unique_ptr<std::byte[]>> blocks_;
+
+		std::byte* current_ = inline_storage_;
+		size_t remaining_ = inline_size;
+
+		destructor* destructors_ = nullptr;
+		size_t allocations_ = 0;
+	};
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include "byte_buffer.hpp"
+
+namespace demonware::schema
+{
+	// Wire encoding of a single value. The sizes include the data type byte,
+	// fixed sized values fold into a constant when computing object sizes.
+	template <typename T>
+	struct codec;
+
+	template <typename T, bool (byte_buffer::*Writer)(T), bool (byte_buffer::*Reader)(T*)>
+	struct fixed_codec
+	{
+		static size_t size(const T& /*value*/, const bool data_types)
+		{
+			return sizeof(T) + (data_types ? 1 : 0);
+		}
+
+		static void write(byte_buffer* buffer, const T& value)
+		{
+			(buffer->*Writer)(value);
+		}
+
+		static bool read(byte_buffer* buffer, T* value)
+		{
+			return (buffer->*Reader)(value);
+		}
+	};
+
+	template <>
+	struct codec<bool> : fixed_codec<bool, &byte_buffer::write_bool, &byte_buffer::read_bool>
+	{
+	};
+
+	template <>
+	struct codec<uint8_t>
+	{
+		static size_t size(const uint8_t& /*value*/, const bool data_types)
+		{
+			return 1 + (data_types ? 1 : 0);
+		}
+
+		static void write(byte_buffer* buffer, const uint8_t value)
+		{
+			buffer->write_byte(static_cast<char>(value));
+		}
+
+		static bool read(byte_buffer* buffer, uint8_t* value)
+		{
+			return buffer->read_byte(value);
+		}
+	};
+
+	template <>
+	struct codec<short> : fixed_codec<short, &byte_buffer::write_int16, &byte_buffer::read_int16>
+	{
+	};
+
+	template <>
+	struct codec<unsigned short> : fixed_codec<unsigned short, &byte_buffer::write_uint16, &byte_buffer::read_uint16>
+	{
+	};
+
+	template <>
+	struct codec<int> : fixed_codec<int, &byte_buffer::write_int32, &byte_buffer::read_int32>
+	{
+	};
+
+	template <>
+	struct codec<unsigned int> : fixed_codec<unsigned int, &byte_buffer::write_uint32, &byte_buffer::read_uint32>
+	{
+	};
+
+	template <>
+	struct codec<__int64> : fixed_codec<__int64, &byte_buffer::write_int64, &byte_buffer::read_int64>
+	{
+	};
+
+	template <>
+	struct codec<unsigned __int64> : fixed_codec<unsigned __int64, &byte_buffer::write_uint64,
+	                                             &byte_buffer::read_uint64>
+	{
+	};
+
+	template <>
+	struct codec<float> : fixed_codec<float, &byte_buffer::write_float, &byte_buffer::read_float>
+	{
+	};
+
+	template <>
+	struct codec<std::string>
+	{
+		static size_t size(const std::string& value, const bool data_types)
+		{
+			// Strings are written up to the first null character
+			return std::strlen(value.data()) + 1 + (data_types ? 1 : 0);
+		}
+
+		static void write(byte_buffer* buffer, const std::string& value)
+		{
+			buffer->write_string(value);
+		}
+
+		static bool read(byte_buffer* buffer, std::string* value)
+		{
+			return buffer->read_string(value);
+		}
+	};
+
+	struct blob_codec
+	{
+		static size_t size(const std::string& value, const bool data_types)
+		{
+			return value.size() + sizeof(uint32_t) + (data_types ? 2 : 0);
+		}
+
+		static void write(byte_buffer* buffer, const std::string& value)
+		{
+			buffer->write_blob(value);
+		}
+
+		static bool read(byte_buffer* buffer, std::string* value)
+		{
+			return buffer->read_blob(value);
+		}
+	};
+
+	template <typename T>
+	struct member_pointer;
+
+	template <typename Class, typename T>
+	struct member_pointer<T Class::*>
+	{
+		using class_type = Class;
+		using value_type = T;
+	};
+
+	// A member encoded with its default codec
+	template <auto Member>
+	struct field
+	{
+		using codec = schema::codec<typename member_pointer<decltype(Member)>::value_type>;
+
+		template <typename T>
+		static const auto& get(const T& object)
+		{
+			return object.*Member;
+		}
+
+		template <typename T>
+		static auto& get(T& object)
+		{
+			return object.*Member;
+		}
+	};
+
+	// A string member encoded as a length-prefixed blob
+	template <auto Member>
+	struct blob : field<Member>
+	{
+		using codec = blob_codec;
+	};
+
+	template <typename T>
+	concept described = requires { typename T::fields; };
+
+	template <typename T>
+	size_t size(const T& object, bool data_types);
+
+	template <typename T>
+	void write(const T& object, byte_buffer* buffer);
+
+	template <typename T>
+	bool read(T& object, byte_buffer* buffer);
+
+	// Everything a base class writes, in front of the derived members.
+	// Bases without a description fall back to their own serialize, called non-virtually.
+	template <typename Base>
+	struct base
+	{
+		struct codec
+		{
+			static size_t size(const Base& value, const bool data_types)
+			{
+				if constexpr (described<Base>) return schema::size(value, data_types);
+				else if constexpr (requires { value.get_size(data_types); }) return value.get_size(data_types);
+				else return 0;
+			}
+
+			static void write(byte_buffer* buffer, const Base& value)
+			{
+				if constexpr (described<Base>) Base::fields::write(value, buffer);
+				else const_cast<Base&>(value).Base::serialize(buffer);
+			}
+
+			static bool read(byte_buffer* buffer, Base* value)
+			{
+				if constexpr (described<Base>) return Base::fields::read(*value, buffer);
+				else value->Base::deserialize(buffer);
+				return true;
+			}
+		};
+
+		template <typename T>
+		static const Base& get(const T& object)
+		{
+			return object;
+		}
+
+		template <typename T>
+		static Base& get(T& object)
+		{
+			return object;
+		}
+	};
+
+	// Wire layout of a type, listed in the order the members are sent
+	template <typename... Fields>
+	struct fields
+	{
+		template <typename T>
+		static size_t size(const T& object, const bool data_types)
+		{
+			return (Fields::codec::size(Fields::get(object), data_types) + ... + 0);
+		}
+
+		template <typename T>
+		static void write(const T& object, byte_buffer* buffer)
+		{
+			(Fields::codec::write(buffer, Fields::get(object)), ...);
+		}
+
+		template <typename T>
+		static bool read(T& object, byte_buffer* buffer)
+		{
+			return (Fields::codec::read(buffer, &Fields::get(object)) && ...);
+		}
+	};
+
+	template <typename T>
+	size_t size(const T& object, const bool data_types)
+	{
+		return T::fields::size(object, data_types);
+	}
+
+	template <typename T>
+	void write(const T& object, byte_buffer* buffer)
+	{
+		// A single reservation for the whole object, growing geometrically
+		// so that objects written back to back don't reallocate every time
+		auto& data = buffer->get_buffer();
+		const auto required = data.size() + size(object, buffer->is_using_data_types());
+		if (required > data.capacity())
+		{
+			data.reserve(std::max(required, data.capacity() * 2));
+		}
+
+		T::fields::write(object, buffer);
+	}
+
+	template <typename T>
+	bool read(T& object, byte_buffer* buffer)
+	{
+		return T::fields::read(object, buffer);
+	}
+
+	// Implements i_serializable from the type's field list
+	template <typename T, typename Base>
+	class serializable : public Base
+	{
+	public:
+		void serialize(byte_buffer* buffer) override
+		{
+			schema::write(static_cast<const T&>(*this), buffer);
+		}
+
+		void deserialize(byte_buffer* buffer) override
+		{
+			schema::read(static_cast<T&>(*this), buffer);
+		}
+	};
+}
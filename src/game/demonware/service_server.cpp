@@ -1,12 +1,13 @@
 #include <std_include.hpp>
-#include "module/dw.hpp"
+#include "service_server.hpp"
+#include "service_session.hpp"
 #include "utils/cryptography.hpp"
 
 namespace demonware
 {
 	std::string unencrypted_reply::get_data()
 	{
-		byte_buffer result;
+		byte_buffer result(this->buffer_.size() + 8);
 		result.set_use_data_types(false);
 
 		result.write_int32(static_cast<int>(this->buffer_.size()) + 2);
@@ -17,35 +18,52 @@ namespace demonware
 		return result.get_buffer();
 	}
 
+	namespace
+	{
+		constexpr size_t encrypted_header_size = 9;
+	}
+
 	std::string encrypted_reply::get_data()
 	{
-		byte_buffer result;
-		result.set_use_data_types(false);
+		byte_buffer result(encrypted_header_size + this->buffer_.size() + 5 + 8);
+		write_header(&result, this->get_type());
+		result.write(this->buffer_);
 
-		byte_buffer enc_buffer;
-		enc_buffer.set_use_data_types(false);
-		enc_buffer.write_int32(0xDEADBEEF);
-		enc_buffer.write_byte(this->get_type());
-		enc_buffer.write(this->buffer_);
+		return seal(&result, *this->crypto_);
+	}
 
-		auto data = enc_buffer.get_buffer();
+	void encrypted_reply::write_header(byte_buffer* buffer, const uint8_t type)
+	{
+		buffer->set_use_data_types(false);
 
-		auto size = enc_buffer.size();
-		size = ~7 & (size + 7); // 8 byte align
-		data.resize(size);
+		// Size is filled in by seal
+		buffer->write_int32(0);
+		buffer->write_byte(true);
+		buffer->write_int32(crypto_session::reply_seed);
 
-		result.write_int32(static_cast<int>(size) + 5);
-		result.write_byte(true);
+		buffer->write_int32(0xDEADBEEF);
+		buffer->write_byte(type);
 
-		auto seed = 0x13371337;
-		result.write_int32(seed);
+		buffer->set_use_data_types(true);
+	}
 
-		const auto iv = utils::cryptography::tiger::compute(std::string(reinterpret_cast<char*>(&seed), 4));
+	std::string encrypted_reply::seal(byte_buffer* buffer, const crypto_session& crypto)
+	{
+		auto& data = buffer->get_buffer();
 
-		const std::string key(reinterpret_cast<char*>(dw::get_key(true)), 24);
-		result.write(utils::cryptography::des3::encrypt(data, iv, key));
+		auto size = data.size() - encrypted_header_size;
+		size = ~7 & (size + 7); // 8 byte align
 
-		return result.get_buffer();
+		data.resize(encrypted_header_size + size);
+
+		const auto frame_size = static_cast<int>(size) + 5;
+		std::memcpy(data.data(), &frame_size, sizeof(frame_size));
+
+		// Encrypt in place, right behind the header
+		auto* payload = reinterpret_cast<uint8_t*>(data.data()) + encrypted_header_size;
+		crypto.encrypt(crypto_session::reply_seed, payload, payload, size);
+
+		return std::move(data);
 	}
 
 	service_server::service_server(std::string _name) : name_(std::move(_name))
@@ -58,54 +76,33 @@ namespace demonware
 		return this->address_;
 	}
 
-	int service_server::send(const char* buf, const int len)
+	std::shared_ptr<service_session> service_server::create_session()
 	{
-		if (len <= 3) return -1;
-		std::lock_guard<std::recursive_mutex> _(this->mutex_);
-
-		this->incoming_queue_.push(std::string(buf, len));
-
-		return len;
+		return std::make_shared<service_session>(this->shared_from_this());
 	}
 
-	int service_server::recv(char* buf, int len)
+	const std::string& service_server::get_name() const
 	{
-		if (len > 0 && !this->outgoing_queue_.empty())
-		{
-			std::lock_guard<std::recursive_mutex> _(this->mutex_);
-
-			len = std::min(len, static_cast<int>(this->outgoing_queue_.size()));
-			for (auto i = 0; i < len; ++i)
-			{
-				buf[i] = this->outgoing_queue_.front();
-				this->outgoing_queue_.pop();
-			}
-
-			return len;
-		}
-
-		return SOCKET_ERROR;
+		return this->name_;
 	}
 
-	void service_server::send_reply(reply* data)
+	const i_service* service_server::get_service(const uint8_t type) const
 	{
-		if (!data) return;
-
-		std::lock_guard _(this->mutex_);
+		return this->services_[type].get();
+	}
 
-		this->reply_sent_ = true;
-		const auto buffer = data->get_data();
-		for (auto& byte : buffer)
-		{
-			this->outgoing_queue_.push(byte);
-		}
+	uint64_t service_server::get_call_count(const uint8_t type) const
+	{
+		return this->calls_[type];
 	}
 
-	void service_server::call_handler(const uint8_t type, const std::string& data)
+	void service_server::call_handler(i_server* server, const uint8_t type, const std::string_view& data)
 	{
-		if (this->services_.find(type) != this->services_.end())
+		const auto& service = this->services_[type];
+		if (service)
 		{
-			this->services_[type]->call_service(this, data);
+			++this->calls_[type];
+			service->call_service(server, data);
 		}
 		else
 		{
@@ -113,88 +110,29 @@ namespace demonware
 		}
 	}
 
-	void service_server::run_frame()
+	void service_server::track_queued_packet()
 	{
-		if (!this->incoming_queue_.empty())
-		{
-			std::lock_guard _(this->mutex_);
-			const auto packet = this->incoming_queue_.front();
-			this->incoming_queue_.pop();
-
-			this->parse_packet(packet);
-		}
+		const auto depth = ++this->queue_depth_;
+		if (depth > this->max_queue_depth_) this->max_queue_depth_ = depth;
 	}
 
-	void service_server::parse_packet(const std::string& packet)
+	void service_server::track_handled_packet(const std::chrono::microseconds wait)
 	{
-		byte_buffer buffer(packet);
-		buffer.set_use_data_types(false);
+		--this->queue_depth_;
+		++this->packets_handled_;
 
-		try
-		{
-			while (buffer.has_more_data())
-			{
-				int size;
-				buffer.read_int32(&size);
-
-				if (size <= 0)
-				{
-					const std::string zero("\x00\x00\x00\x00", 4);
-
-					raw_reply reply(zero);
-					this->send_reply(&reply);
-					return;
-				}
-				else if (size == 200) // Connection id
-				{
-					byte_buffer bbufer;
-					bbufer.write_uint64(0x00000000000000FD);
-
-					auto reply = this->create_message(4);
-					reply->send(&bbufer, false);
-					return;
-				}
-
-				if (buffer.size() < size_t(size)) return;
-
-				byte_buffer p_buffer;
-				p_buffer.set_use_data_types(false);
-				p_buffer.get_buffer().resize(size);
-				buffer.read(size, p_buffer.get_buffer().data());
-
-				bool enc;
-				p_buffer.read_bool(&enc);
-
-				if (enc)
-				{
-					int iv;
-					p_buffer.read_int32(&iv);
-
-					auto iv_hash = utils::cryptography::tiger::compute(std::string(reinterpret_cast<char*>(&iv), 4));
-
-					const std::string key(reinterpret_cast<char*>(dw::get_key(false)), 24);
-					p_buffer = byte_buffer{utils::cryptography::des3::decrypt(p_buffer.get_remaining(), iv_hash, key)};
-					p_buffer.set_use_data_types(false);
-
-					int checksum;
-					p_buffer.read_int32(&checksum);
-				}
-
-				uint8_t type;
-				p_buffer.read_byte(&type);
-				printf("DW: Handling message of type %d (encrypted: %d)\n", type, enc);
-
-				this->reply_sent_ = false;
-				this->call_handler(type, p_buffer.get_remaining());
-
-				if (!this->reply_sent_ && type != 7)
-				{
-					this->create_reply(type)->send();
-				}
-			}
-		}
-		catch (...)
-		{
-		}
+		this->total_queue_wait_ += wait.count();
+		if (wait.count() > this->max_queue_wait_) this->max_queue_wait_ = wait.count();
+	}
+
+	service_server::statistics service_server::get_statistics() const
+	{
+		statistics stats{};
+		stats.queue_depth = this->queue_depth_;
+		stats.max_queue_depth = this->max_queue_depth_;
+		stats.packets_handled = this->packets_handled_;
+		stats.total_queue_wait = std::chrono::microseconds(this->total_queue_wait_);
+		stats.max_queue_wait = std::chrono::microseconds(this->max_queue_wait_);
+		return stats;
 	}
 }
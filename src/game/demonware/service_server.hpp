@@ -3,9 +3,20 @@
 
 namespace demonware
 {
-	class service_server final : public i_server
+	class service_session;
+
+	class service_server final : public std::enable_shared_from_this<service_server>
 	{
 	public:
+		struct statistics
+		{
+			size_t queue_depth;
+			size_t max_queue_depth;
+			uint64_t packets_handled;
+			std::chrono::microseconds total_queue_wait;
+			std::chrono::microseconds max_queue_wait;
+		};
+
 		explicit service_server(std::string name);
 
 		template <typename T>
@@ -15,29 +26,36 @@ namespace demonware
 
 			auto service = std::make_unique<T>();
 			const uint16_t type = service->getType();
+			assert(type < this->services_.size());
 
 			this->services_[type] = std::move(service);
 		}
 
 		unsigned long get_address() const;
+		const std::string& get_name() const;
+
+		const i_service* get_service(uint8_t type) const;
+		uint64_t get_call_count(uint8_t type) const;
+
+		std::shared_ptr<service_session> create_session();
+		void call_handler(i_server* server, uint8_t type, const std::string_view& data);
 
-		int send(const char* buf, int len) override;
-		int recv(char* buf, int len) override;
-		void send_reply(reply* data) override;
+		void track_queued_packet();
+		void track_handled_packet(std::chrono::microseconds wait);
 
-		void call_handler(uint8_t type, const std::string& data);
-		void run_frame();
+		statistics get_statistics() const;
 
 	private:
 		std::string name_;
 
-		std::recursive_mutex mutex_;
-		std::queue<char> outgoing_queue_;
-		std::queue<std::string> incoming_queue_;
-		std::map<uint16_t, std::unique_ptr<i_service>> services_;
+		std::array<std::unique_ptr<i_service>, 256> services_{};
+		std::array<std::atomic<uint64_t>, 256> calls_{};
 		unsigned long address_ = 0;
-		bool reply_sent_ = false;
 
-		void parse_packet(const std::string& packet);
+		std::atomic<size_t> queue_depth_{0};
+		std::atomic<size_t> max_queue_depth_{0};
+		std::atomic<uint64_t> packets_handled_{0};
+		std::atomic<int64_t> total_queue_wait_{0};
+		std::atomic<int64_t> max_queue_wait_{0};
 	};
 }
@@ -0,0 +1,268 @@
+#include <std_include.hpp>
+#include "core.hpp"
+#include "service_server.hpp"
+#include "service_session.hpp"
+
+namespace demonware
+{
+	service_session::service_session(std::shared_ptr<service_server> server) : server_(std::move(server))
+	{
+	}
+
+	const std::shared_ptr<service_server>& service_session::get_server() const
+	{
+		return this->server_;
+	}
+
+	int service_session::send(const char* buf, const int len)
+	{
+		if (len <= 0) return -1;
+
+		{
+			std::lock_guard<std::recursive_mutex> _(this->mutex_);
+			this->incoming_queue_.push({std::string(buf, len), std::chrono::high_resolution_clock::now()});
+			this->server_->track_queued_packet();
+		}
+
+		core::get().schedule(this->shared_from_this());
+		return len;
+	}
+
+	int service_session::recv(char* buf, const int len)
+	{
+		if (len > 0)
+		{
+			std::lock_guard<std::recursive_mutex> _(this->mutex_);
+
+			if (!this->outgoing_queue_.empty())
+			{
+				return static_cast<int>(this->outgoing_queue_.read(buf, len));
+			}
+		}
+
+		return SOCKET_ERROR;
+	}
+
+	size_t service_session::gather(std::vector<std::string_view>* output, const size_t len)
+	{
+		std::lock_guard<std::recursive_mutex> _(this->mutex_);
+		return this->outgoing_queue_.gather(output, len);
+	}
+
+	void service_session::consume(const size_t len)
+	{
+		std::lock_guard<std::recursive_mutex> _(this->mutex_);
+		this->outgoing_queue_.consume(len);
+	}
+
+	void service_session::send_reply(reply* data)
+	{
+		if (!data) return;
+
+		std::function<void()> handler;
+
+		{
+			std::lock_guard _(this->mutex_);
+
+			this->reply_sent_ = true;
+			this->outgoing_queue_.push(data->get_data());
+
+			if (this->running_) this->reply_pending_ = true;
+			else handler = this->reply_handler_;
+		}
+
+		if (handler) handler();
+	}
+
+	crypto_session& service_session::get_crypto()
+	{
+		return this->crypto_;
+	}
+
+	void service_session::set_reply_handler(std::function<void()> handler)
+	{
+		std::lock_guard _(this->mutex_);
+		this->reply_handler_ = std::move(handler);
+	}
+
+	void service_session::defer(std::function<void()> work)
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->deferred_ = true;
+		}
+
+		core::get().submit_io([self = this->shared_from_this(), work = std::move(work)]()
+		{
+			try
+			{
+				work();
+			}
+			catch (...)
+			{
+			}
+
+			self->resume();
+		});
+	}
+
+	void service_session::resume()
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->deferred_ = false;
+			this->resumed_ = true;
+		}
+
+		core::get().schedule(this->shared_from_this());
+	}
+
+	bool service_session::schedule()
+	{
+		return !this->scheduled_.exchange(true);
+	}
+
+	bool service_session::has_pending_data()
+	{
+		std::lock_guard _(this->mutex_);
+		return !this->deferred_ && (this->resumed_ || !this->incoming_queue_.empty());
+	}
+
+	void service_session::run_frame()
+	{
+		std::function<void()> handler;
+
+		{
+			std::lock_guard _(this->mutex_);
+			this->resumed_ = false;
+			this->running_ = true;
+
+			while (!this->incoming_queue_.empty())
+			{
+				const auto packet = std::move(this->incoming_queue_.front());
+				this->incoming_queue_.pop();
+
+				this->server_->track_handled_packet(std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::high_resolution_clock::now() - packet.queued));
+
+				this->incoming_buffer_.append(packet.data);
+			}
+
+			this->parse_packets();
+			this->running_ = false;
+
+			if (this->reply_pending_)
+			{
+				this->reply_pending_ = false;
+				handler = this->reply_handler_;
+			}
+		}
+
+		// Data that arrived while we were busy couldn't queue another frame
+		this->scheduled_ = false;
+		core::get().schedule(this->shared_from_this());
+
+		if (handler) handler();
+	}
+
+	void service_session::parse_packets()
+	{
+		// Messages can be split across or pipelined into arbitrary sends,
+		// so only complete frames are handled and the rest is kept for the next run
+		const std::string_view data(this->incoming_buffer_);
+		size_t offset = 0;
+
+		while (!this->deferred_ && data.size() - offset >= sizeof(int))
+		{
+			int size;
+			std::memcpy(&size, data.data() + offset, sizeof(size));
+
+			if (size <= 0)
+			{
+				const std::string zero("\x00\x00\x00\x00", 4);
+
+				raw_reply reply(zero);
+				this->send_reply(&reply);
+
+				offset += sizeof(size);
+				continue;
+			}
+
+			if (size == 200) // Connection id
+			{
+				byte_buffer bbufer;
+				bbufer.write_uint64(0x00000000000000FD);
+
+				auto reply = this->create_message(4);
+				reply->send(&bbufer, false);
+
+				// Whatever was sent along with the handshake is parsed as usual
+				offset += sizeof(size);
+				continue;
+			}
+
+			if (size_t(size) > max_message_size)
+			{
+				printf("DW: Dropping message of invalid size %d\n", size);
+				offset = data.size();
+				break;
+			}
+
+			if (data.size() - offset - sizeof(size) < size_t(size)) break;
+
+			const auto message = data.substr(offset + sizeof(size), size);
+			offset += sizeof(size) + size;
+
+			// The frame is already consumed, a failing message doesn't hold up the ones behind it
+			try
+			{
+				this->handle_message(message);
+			}
+			catch (...)
+			{
+			}
+		}
+
+		this->incoming_buffer_.erase(0, offset);
+	}
+
+	void service_session::handle_message(const std::string_view& message)
+	{
+		byte_view p_buffer(message);
+		p_buffer.set_use_data_types(false);
+
+		bool enc;
+		p_buffer.read_bool(&enc);
+
+		std::string decrypted;
+		if (enc)
+		{
+			int iv;
+			p_buffer.read_int32(&iv);
+
+			const auto remaining = p_buffer.get_remaining();
+			decrypted.resize(remaining.size());
+
+			this->crypto_.decrypt(iv, reinterpret_cast<const uint8_t*>(remaining.data()),
+			                    reinterpret_cast<uint8_t*>(decrypted.data()), remaining.size());
+
+			p_buffer = byte_view{decrypted};
+			p_buffer.set_use_data_types(false);
+
+			int checksum;
+			p_buffer.read_int32(&checksum);
+		}
+
+		uint8_t type;
+		p_buffer.read_byte(&type);
+		printf("DW: Handling message of type %d (encrypted: %d)\n", type, enc);
+
+		this->reply_sent_ = false;
+		this->server_->call_handler(this, type, p_buffer.get_remaining());
+
+		if (!this->reply_sent_ && !this->deferred_ && type != 7)
+		{
+			this->create_reply(type)->send();
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "i_server.hpp"
+#include "byte_queue.hpp"
+
+namespace demonware
+{
+	class service_server;
+
+	// A single connection to a service_server.
+	// Framing state and queues are per connection, the services are shared.
+	class service_session final : public i_server, public std::enable_shared_from_this<service_session>
+	{
+	public:
+		explicit service_session(std::shared_ptr<service_server> server);
+
+		int send(const char* buf, int len) override;
+		int recv(char* buf, int len) override;
+		void send_reply(reply* data) override;
+		void defer(std::function<void()> work) override;
+		crypto_session& get_crypto() override;
+
+		// Called whenever a reply is queued, lets real sockets push it out
+		// instead of waiting for the client to poll
+		void set_reply_handler(std::function<void()> handler);
+
+		// Views of pending outgoing data, valid until consume is called
+		size_t gather(std::vector<std::string_view>* output, size_t len = SIZE_MAX);
+		void consume(size_t len);
+
+		// Returns false if the session is already queued for processing
+		bool schedule();
+		bool has_pending_data();
+
+		void run_frame();
+
+		const std::shared_ptr<service_server>& get_server() const;
+
+	private:
+		static constexpr size_t max_message_size = 0x1000000;
+
+		struct queued_packet
+		{
+			std::string data;
+			std::chrono::high_resolution_clock::time_point queued;
+		};
+
+		std::shared_ptr<service_server> server_;
+
+		std::recursive_mutex mutex_;
+		byte_queue outgoing_queue_;
+		std::queue<queued_packet> incoming_queue_;
+		std::string incoming_buffer_;
+		bool reply_sent_ = false;
+
+		crypto_session crypto_;
+		std::function<void()> reply_handler_;
+
+		// Replies sent by handlers during run_frame notify once the frame released the lock
+		bool running_ = false;
+		bool reply_pending_ = false;
+
+		// Set while deferred work is in flight, parsing resumes once it completes
+		bool deferred_ = false;
+		bool resumed_ = false;
+
+		std::atomic<bool> scheduled_{false};
+
+		void resume();
+		void parse_packets();
+		void handle_message(const std::string_view& message);
+	};
+}
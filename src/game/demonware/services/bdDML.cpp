@@ -6,12 +6,14 @@ namespace demonware
 {
 	bdDML::bdDML()
 	{
-		this->register_service(2, &bdDML::get_user_raw_data);
+		this->register_service<&bdDML::get_user_raw_data>(2);
 	}
 
-	void bdDML::get_user_raw_data(i_server* server, byte_buffer* /*buffer*/) const
+	void bdDML::get_user_raw_data(const service_context& context, byte_view* /*buffer*/) const
 	{
-		auto result = new bdDMLRawData;
+		auto reply = context.create_reply();
+
+		auto* result = reply->create<bdDMLRawData>();
 		result->country_code = "US";
 		result->country_code = "'Murica";
 		result->region = "New York";
@@ -22,8 +24,6 @@ namespace demonware
 		result->asn = 0x2119;
 		result->timezone = "+01:00";
 
-		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(result);
 		reply->send();
 	}
 }
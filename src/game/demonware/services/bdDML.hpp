@@ -9,6 +9,6 @@ namespace demonware
 		bdDML();
 
 	private:
-		void get_user_raw_data(i_server* server, byte_buffer* buffer) const;
+		void get_user_raw_data(const service_context& context, byte_view* buffer) const;
 	};
 }
@@ -1,12 +1,11 @@
 #include <std_include.hpp>
 #include "bdLSGHello.hpp"
-#include "module/dw.hpp"
 
 namespace demonware
 {
-	void bdLSGHello::call_service(i_server* server, const std::string& data)
+	void bdLSGHello::call_service(i_server* server, const std::string_view& data)
 	{
-		bit_buffer buffer(data);
+		bit_buffer buffer{std::string(data)};
 
 		bool more_data;
 		buffer.set_use_data_types(false);
@@ -20,7 +19,7 @@ namespace demonware
 		uint8_t ticket[128];
 		buffer.read_bytes(sizeof(ticket), ticket);
 
-		dw::set_key(true, ticket);
-		dw::set_key(false, ticket);
+		server->get_crypto().set_key(true, ticket);
+		server->get_crypto().set_key(false, ticket);
 	}
 }
@@ -1,24 +1,23 @@
 #include <std_include.hpp>
 #include "bdStorage.hpp"
-#include "../data_types.hpp"
+#include "../core.hpp"
 #include "utils/cryptography.hpp"
 #include "utils/nt.hpp"
-#include "utils/io.hpp"
 #include "utils/string.hpp"
 
 namespace demonware
 {
 	bdStorage::bdStorage()
 	{
-		this->register_service(1, &bdStorage::set_legacy_user_file);
-		this->register_service(3, &bdStorage::get_legacy_user_file);
-		this->register_service(5, &bdStorage::list_legacy_user_files);
-		this->register_service(6, &bdStorage::list_publisher_files);
-		this->register_service(7, &bdStorage::get_publisher_file);
-		this->register_service(8, &bdStorage::update_legacy_user_file);
-		this->register_service(10, &bdStorage::set_user_file);
-		this->register_service(11, &bdStorage::delete_user_file);
-		this->register_service(12, &bdStorage::get_user_file);
+		this->register_service<&bdStorage::set_legacy_user_file>(1);
+		this->register_service<&bdStorage::get_legacy_user_file>(3);
+		this->register_service<&bdStorage::list_legacy_user_files>(5);
+		this->register_service<&bdStorage::list_publisher_files>(6);
+		this->register_service<&bdStorage::get_publisher_file>(7);
+		this->register_service<&bdStorage::update_legacy_user_file>(8);
+		this->register_service<&bdStorage::set_user_file>(10);
+		this->register_service<&bdStorage::delete_user_file>(11);
+		this->register_service<&bdStorage::get_user_file>(12);
 
 		this->map_publisher_resource("heatmap\\.raw", DW_HEATMAP);
 		this->map_publisher_resource("motd-.*\\.txt", DW_MOTD);
@@ -28,6 +27,9 @@ namespace demonware
 		this->map_publisher_resource("social_[Tt][Uu][0-9]+\\.cfg", DW_CONFIG);
 		this->map_publisher_resource("iotd-.*\\.txt", DW_IOTD_TXT);
 		this->map_publisher_resource("iotd-.*\\.jpg", DW_IOTD_IMG);
+
+		// Loose files take precedence over the embedded ones
+		this->map_publisher_directory("players2/publisher");
 	}
 
 	void bdStorage::map_publisher_resource(const std::string& expression, const INT id)
@@ -38,33 +40,137 @@ namespace demonware
 		const auto handle = LoadResource(nullptr, res);
 		if (!handle) return;
 
-		std::string data(LPSTR(LockResource(handle)), SizeofResource(nullptr, res));
+		// Resources stay mapped for the lifetime of the module
+		const std::string_view data(LPSTR(LockResource(handle)), SizeofResource(nullptr, res));
 
-		publisher_resources_.emplace_back(std::regex{expression}, data);
+		publisher_resources_.emplace_back(std::regex{expression, std::regex::optimize}, data);
 	}
 
-	bool bdStorage::load_publisher_resource(const std::string& name, std::string& buffer)
+	void bdStorage::map_publisher_directory(const std::string& directory)
 	{
+		if (!utils::io::directory_exists(directory)) return;
+
+		for (const auto& path : utils::io::list_files(directory))
+		{
+			if (!std::filesystem::is_regular_file(path)) continue;
+
+			utils::io::mapped_file file(path);
+			if (!file.is_valid()) continue;
+
+			const auto name = path.substr(path.find_last_of('/') + 1);
+			const auto id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(name).data());
+
+			this->resolved_publisher_files_[name] = publisher_file{file.get_data(), id};
+			this->publisher_files_.emplace_back(std::move(file));
+		}
+	}
+
+	std::optional<bdStorage::publisher_file> bdStorage::resolve_publisher_file(const std::string& name)
+	{
+		{
+			std::shared_lock _(this->publisher_mutex_);
+
+			const auto resolved = this->resolved_publisher_files_.find(name);
+			if (resolved != this->resolved_publisher_files_.end())
+			{
+				return resolved->second;
+			}
+		}
+
+		std::optional<publisher_file> file;
 		for (const auto& resource : this->publisher_resources_)
 		{
 			if (std::regex_match(name, resource.first))
 			{
-				buffer = resource.second;
-				return true;
+				const auto id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(name).data());
+				file = publisher_file{resource.second, id};
+				break;
 			}
 		}
 
-		printf("DW: Missing publisher file: %s\n", name.data());
+		if (!file)
+		{
+			printf("DW: Missing publisher file: %s\n", name.data());
+		}
+
+		std::unique_lock _(this->publisher_mutex_);
+
+		// Names come from the client, so the memo must not grow without bound
+		if (this->resolved_publisher_files_.size() < max_resolved_publisher_files)
+		{
+			this->resolved_publisher_files_.emplace(name, file);
+		}
+
+		return file;
+	}
 
-		return false;
+	void bdStorage::add_file_info(service_reply* reply, const user_storage::file_info& file)
+	{
+		auto* info = reply->create<bdFileInfo>();
+
+		info->file_id = file.file_id;
+		info->filename = file.filename;
+		info->create_time = file.create_time;
+		info->modified_time = file.modified_time;
+		info->file_size = file.size;
+		info->owner_id = file.owner;
+		info->priv = file.priv;
 	}
 
-	std::string bdStorage::get_user_file_path(const std::string& name)
+	std::optional<std::regex> bdStorage::create_filter(const std::string& filter, std::string* prefix)
 	{
-		return "players2/user/" + name;
+		const auto wildcard = filter.find_first_of("*?");
+		*prefix = filter.substr(0, wildcard);
+
+		// Plain prefix queries are answered from the index alone
+		if (filter.empty() || (wildcard == filter.size() - 1 && filter.back() == '*'))
+		{
+			return {};
+		}
+
+		std::string expression;
+		for (const auto chr : filter)
+		{
+			if (chr == '*') expression.append(".*");
+			else if (chr == '?') expression.push_back('.');
+			else
+			{
+				if (std::strchr("\\^$.|+()[]{}", chr)) expression.push_back('\\');
+				expression.push_back(chr);
+			}
+		}
+
+		return std::regex{expression};
 	}
 
-	void bdStorage::set_legacy_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::send_user_file(const service_context& context, const std::string& id)
+	{
+		std::string data;
+		if (core::get().get_user_storage().try_read(id, &data))
+		{
+			auto reply = context.create_reply();
+			reply->create<bdFileData>(std::move(data));
+			reply->send();
+			return;
+		}
+
+		context.defer([id](const service_context& request)
+		{
+			std::string data;
+			if (core::get().get_user_storage().read(id, &data))
+			{
+				auto reply = request.create_reply();
+				reply->create<bdFileData>(std::move(data));
+				reply->send();
+			}
+			else
+			{
+				request.create_reply(game::native::BD_NO_FILE)->send();
+			}
+		});
+	}
+
+	void bdStorage::set_legacy_user_file(const service_context& context, byte_view* buffer) const
 	{
 		bool priv;
 		std::string filename, data;
@@ -78,25 +184,14 @@ namespace demonware
 
 		printf("DW: Storing user file '%s' as %s\n", filename.data(), id_string.data());
 
-		const auto path = get_user_file_path(id_string);
-		utils::io::write_file(path, data);
-
-		auto info = new bdFileInfo;
+		const auto file = core::get().get_user_storage().write(id_string, std::move(data), id, filename, 0, priv);
 
-		info->file_id = id;
-		info->filename = filename;
-		info->create_time = uint32_t(time(nullptr));
-		info->modified_time = info->create_time;
-		info->file_size = uint32_t(data.size());
-		info->owner_id = 0;
-		info->priv = priv;
-
-		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(info);
+		auto reply = context.create_reply();
+		add_file_info(reply.get(), file);
 		reply->send();
 	}
 
-	void bdStorage::update_legacy_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::update_legacy_user_file(const service_context& context, byte_view* buffer) const
 	{
 		uint64_t id;
 		std::string data;
@@ -108,27 +203,16 @@ namespace demonware
 
 		printf("DW: Updating user file %s\n", id_string.data());
 
-		const auto path = get_user_file_path(id_string);
-		utils::io::write_file(path, data);
-
-		auto info = new bdFileInfo;
-
-		info->file_id = id;
-		info->filename = "<>";
-		info->create_time = uint32_t(time(nullptr));
-		info->modified_time = info->create_time;
-		info->file_size = uint32_t(data.size());
-		info->owner_id = 0;
-		info->priv = false;
+		const auto file = core::get().get_user_storage().write(id_string, std::move(data), id, {}, 0, false);
 
-		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(info);
+		auto reply = context.create_reply();
+		add_file_info(reply.get(), file);
 		reply->send();
 	}
 
-	void bdStorage::get_legacy_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::get_legacy_user_file(const service_context& context, byte_view* buffer) const
 	{
-		std::string filename, data;
+		std::string filename;
 		buffer->read_string(&filename);
 
 		const auto id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
@@ -136,105 +220,96 @@ namespace demonware
 
 		printf("DW: Loading user file: %s (%s)\n", filename.data(), id_string.data());
 
-		const auto path = get_user_file_path(id_string);
-		if (utils::io::read_file(path, &data))
-		{
-			auto reply = server->create_reply(this->get_sub_type());
-			reply->add(new bdFileData(data));
-			reply->send();
-		}
-		else
-		{
-			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE)->send();
-		}
+		send_user_file(context, id_string);
 	}
 
-	void bdStorage::list_legacy_user_files(i_server* server, byte_buffer* buffer) const
+	void bdStorage::list_legacy_user_files(const service_context& context, byte_view* buffer) const
 	{
-		uint64_t unk;
+		uint64_t owner;
 		uint32_t date;
 		uint16_t num_results, offset;
-		std::string filename, data;
+		std::string filename;
 
-		buffer->read_uint64(&unk);
+		buffer->read_uint64(&owner);
 		buffer->read_uint32(&date);
 		buffer->read_uint16(&num_results);
 		buffer->read_uint16(&offset);
 		buffer->read_string(&filename);
 
-		auto reply = server->create_reply(this->get_sub_type());
+		// Legacy uploads don't carry their owner, they are stored without one
+		user_storage::query query{};
+		query.owner = owner;
+		query.include_unowned = true;
 
-		const auto path = get_user_file_path(filename);
-		if (utils::io::read_file(path, &data))
-		{
-			auto* info = new bdFileInfo;
+		const auto pattern = create_filter(filename, &query.prefix);
+		query.pattern = pattern ? &*pattern : nullptr;
+		query.min_modified_time = date;
+		query.offset = offset;
+		query.num_results = num_results;
 
-			info->file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
-			info->filename = filename;
-			info->create_time = 0;
-			info->modified_time = info->create_time;
-			info->file_size = uint32_t(data.size());
-			info->owner_id = 0;
-			info->priv = false;
+		// Only the index is consulted, the files themselves are never read
+		auto reply = context.create_reply();
 
-			reply->add(info);
+		for (const auto& file : core::get().get_user_storage().list(query))
+		{
+			add_file_info(reply.get(), file);
 		}
 
 		reply->send();
 	}
 
-	void bdStorage::list_publisher_files(i_server* server, byte_buffer* buffer)
+	void bdStorage::list_publisher_files(const service_context& context, byte_view* buffer)
 	{
 		uint32_t date;
 		uint16_t num_results, offset;
-		std::string filename, data;
+		std::string filename;
 
 		buffer->read_uint32(&date);
 		buffer->read_uint16(&num_results);
 		buffer->read_uint16(&offset);
 		buffer->read_string(&filename);
 
-		auto reply = server->create_reply(this->get_sub_type());
+		auto reply = context.create_reply();
 
-		if (this->load_publisher_resource(filename, data))
+		// Every name maps to at most one resource
+		const auto file = offset == 0 ? this->resolve_publisher_file(filename) : std::nullopt;
+		if (file)
 		{
-			auto* info = new bdFileInfo;
+			auto* info = reply->create<bdFileInfo>();
 
-			info->file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
+			info->file_id = file->file_id;
 			info->filename = filename;
 			info->create_time = 0;
 			info->modified_time = info->create_time;
-			info->file_size = uint32_t(data.size());
+			info->file_size = uint32_t(file->data.size());
 			info->owner_id = 0;
 			info->priv = false;
-
-			reply->add(info);
 		}
 
 		reply->send();
 	}
 
-	void bdStorage::get_publisher_file(i_server* server, byte_buffer* buffer)
+	void bdStorage::get_publisher_file(const service_context& context, byte_view* buffer)
 	{
 		std::string filename;
 		buffer->read_string(&filename);
 
 		printf("DW: Loading publisher file: %s\n", filename.data());
 
-		std::string data;
-		if (this->load_publisher_resource(filename, data))
+		const auto file = this->resolve_publisher_file(filename);
+		if (file)
 		{
-			auto reply = server->create_reply(this->get_sub_type());
-			reply->add(new bdFileData(data));
+			auto reply = context.create_reply();
+			reply->create<bdFileData>(std::string(file->data));
 			reply->send();
 		}
 		else
 		{
-			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE)->send();
+			context.create_reply(game::native::BD_NO_FILE)->send();
 		}
 	}
 
-	void bdStorage::delete_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::delete_user_file(const service_context& context, byte_view* buffer) const
 	{
 		uint64_t owner;
 		std::string game, filename;
@@ -245,11 +320,11 @@ namespace demonware
 
 		// Really remove the file?
 
-		auto reply = server->create_reply(this->get_sub_type());
+		auto reply = context.create_reply();
 		reply->send();
 	}
 
-	void bdStorage::set_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::set_user_file(const service_context& context, byte_view* buffer) const
 	{
 		bool priv;
 		uint64_t owner;
@@ -261,44 +336,24 @@ namespace demonware
 		buffer->read_blob(&data);
 		buffer->read_uint64(&owner);
 
-		const auto path = get_user_file_path(filename);
-		utils::io::write_file(path, data);
-
-		auto* info = new bdFileInfo;
-
-		info->file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
-		info->filename = filename;
-		info->create_time = uint32_t(time(nullptr));
-		info->modified_time = info->create_time;
-		info->file_size = uint32_t(data.size());
-		info->owner_id = owner;
-		info->priv = priv;
+		const auto id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
+		const auto file = core::get().get_user_storage().write(filename, std::move(data), id, filename, owner, priv);
 
-		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(info);
+		auto reply = context.create_reply();
+		add_file_info(reply.get(), file);
 		reply->send();
 	}
 
-	void bdStorage::get_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::get_user_file(const service_context& context, byte_view* buffer) const
 	{
 		uint64_t owner{};
-		std::string game, filename, platform, data;
+		std::string game, filename, platform;
 
 		buffer->read_string(&game);
 		buffer->read_string(&filename);
 		buffer->read_uint64(&owner);
 		buffer->read_string(&platform);
 
-		const auto path = get_user_file_path(filename);
-		if (utils::io::read_file(path, &data))
-		{
-			auto reply = server->create_reply(this->get_sub_type());
-			reply->add(new bdFileData(data));
-			reply->send();
-		}
-		else
-		{
-			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE)->send();
-		}
+		send_user_file(context, filename);
 	}
 }
@@ -1,5 +1,8 @@
 #pragma once
 #include "../i_service.hpp"
+#include "../data_types.hpp"
+#include "../user_storage.hpp"
+#include "utils/io.hpp"
 
 namespace demonware
 {
@@ -9,21 +12,37 @@ namespace demonware
 		bdStorage();
 
 	private:
-		std::vector<std::pair<std::regex, std::string>> publisher_resources_;
-
-		void set_legacy_user_file(i_server* server, byte_buffer* buffer) const;
-		void update_legacy_user_file(i_server* server, byte_buffer* buffer) const;
-		void get_legacy_user_file(i_server* server, byte_buffer* buffer) const;
-		void list_legacy_user_files(i_server* server, byte_buffer* buffer) const;
-		void list_publisher_files(i_server* server, byte_buffer* buffer);
-		void get_publisher_file(i_server* server, byte_buffer* buffer);
-		void delete_user_file(i_server* server, byte_buffer* buffer) const;
-		void set_user_file(i_server* server, byte_buffer* buffer) const;
-		void get_user_file(i_server* server, byte_buffer* buffer) const;
+		struct publisher_file
+		{
+			std::string_view data;
+			uint64_t file_id;
+		};
+
+		static constexpr size_t max_resolved_publisher_files = 1024;
+
+		std::vector<std::pair<std::regex, std::string_view>> publisher_resources_;
+		std::vector<utils::io::mapped_file> publisher_files_;
+
+		// Every name is only matched against the expressions once
+		std::shared_mutex publisher_mutex_;
+		std::unordered_map<std::string, std::optional<publisher_file>> resolved_publisher_files_;
+
+		void set_legacy_user_file(const service_context& context, byte_view* buffer) const;
+		void update_legacy_user_file(const service_context& context, byte_view* buffer) const;
+		void get_legacy_user_file(const service_context& context, byte_view* buffer) const;
+		void list_legacy_user_files(const service_context& context, byte_view* buffer) const;
+		void list_publisher_files(const service_context& context, byte_view* buffer);
+		void get_publisher_file(const service_context& context, byte_view* buffer);
+		void delete_user_file(const service_context& context, byte_view* buffer) const;
+		void set_user_file(const service_context& context, byte_view* buffer) const;
+		void get_user_file(const service_context& context, byte_view* buffer) const;
 
 		void map_publisher_resource(const std::string& expression, INT id);
-		bool load_publisher_resource(const std::string& name, std::string& buffer);
+		void map_publisher_directory(const std::string& directory);
+		std::optional<publisher_file> resolve_publisher_file(const std::string& name);
 
-		static std::string get_user_file_path(const std::string& name);
+		static void add_file_info(service_reply* reply, const user_storage::file_info& file);
+		static std::optional<std::regex> create_filter(const std::string& filter, std::string* prefix);
+		static void send_user_file(const service_context& context, const std::string& id);
 	};
 }
@@ -6,16 +6,16 @@ namespace demonware
 {
 	bdTitleUtilities::bdTitleUtilities()
 	{
-		this->register_service(6, &bdTitleUtilities::get_server_time);
+		this->register_service<&bdTitleUtilities::get_server_time>(6);
 	}
 
-	void bdTitleUtilities::get_server_time(i_server* server, byte_buffer* /*buffer*/) const
+	void bdTitleUtilities::get_server_time(const service_context& context, byte_view* /*buffer*/) const
 	{
-		const auto time_result = new bdTimeStamp;
+		auto reply = context.create_reply();
+
+		auto* time_result = reply->create<bdTimeStamp>();
 		time_result->unix_time = uint32_t(time(nullptr));
 
-		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(time_result);
 		reply->send();
 	}
 }
@@ -1,12 +1,13 @@
 #include <std_include.hpp>
 #include <utility>
-#include "module/dw.hpp"
+#include "stun_server.hpp"
 #include "utils/cryptography.hpp"
 #include "byte_buffer.hpp"
+#include "byte_view.hpp"
 
 namespace demonware
 {
-	stun_server::stun_server(std::string _name) : name_(std::move(_name))
+	stun_server::stun_server(std::string _name, nat_simulator* nat) : name_(std::move(_name)), nat_(nat)
 	{
 		this->address_ = utils::cryptography::jenkins_one_at_a_time::compute(this->name_);
 	}
@@ -16,43 +17,40 @@ namespace demonware
 		return this->address_;
 	}
 
-	void stun_server::ip_discovery(SOCKET s, const sockaddr* to, const int tolen) const
+	std::string stun_server::ip_discovery(const endpoint& external) const
 	{
-		const uint32_t ip = 0x0100007f;
-
 		byte_buffer buffer;
 		buffer.set_use_data_types(false);
 		buffer.write_byte(31); // type
 		buffer.write_byte(2); // version
 		buffer.write_byte(0); // version
-		buffer.write_uint32(ip); // external ip
-		buffer.write_uint16(3074); // port
+		buffer.write_uint32(external.address); // external ip
+		buffer.write_uint16(external.port); // port
 
-		dw::send_datagram_packet(s, buffer.get_buffer(), to, tolen);
+		return buffer.get_buffer();
 	}
 
-	void stun_server::nat_discovery(SOCKET s, const sockaddr* to, const int tolen) const
+	std::string stun_server::nat_discovery(const endpoint& external) const
 	{
-		const uint32_t ip = 0x0100007f;
-
 		byte_buffer buffer;
 		buffer.set_use_data_types(false);
 		buffer.write_byte(21); // type
 		buffer.write_byte(2); // version
 		buffer.write_byte(0); // version
-		buffer.write_uint32(ip); // external ip
-		buffer.write_uint16(3074); // port
+		buffer.write_uint32(external.address); // external ip
+		buffer.write_uint16(external.port); // port
 		buffer.write_uint32(this->get_address()); // server ip
 		buffer.write_uint16(3074); // server port
 
-		dw::send_datagram_packet(s, buffer.get_buffer(), to, tolen);
+		return buffer.get_buffer();
 	}
 
-	int stun_server::send(const SOCKET s, const char* buf, const int len, const sockaddr* to, const int tolen) const
+	bool stun_server::handle_packet(const std::string_view& data, const uint64_t client, const endpoint& source,
+	                                std::string* response) const
 	{
-		uint8_t type, version, padding;
+		uint8_t type{}, version{}, padding{};
 
-		byte_buffer buffer(std::string(buf, len));
+		byte_view buffer(data);
 		buffer.set_use_data_types(false);
 		buffer.read_byte(&type);
 		buffer.read_byte(&version);
@@ -61,15 +59,34 @@ namespace demonware
 		switch (type)
 		{
 		case 30:
-			this->ip_discovery(s, to, tolen);
-			break;
+			*response = this->ip_discovery(this->nat_->map(client, source, this->address_));
+			return true;
 		case 20:
-			this->nat_discovery(s, to, tolen);
-			break;
+			// The answer comes from another endpoint, only NATs without filtering let it through
+			if (!this->nat_->accepts_unsolicited()) return false;
+
+			*response = this->nat_discovery(this->nat_->map(client, source, this->address_));
+			return true;
 		default:
-			break;
+			return false;
+		}
+	}
+
+	void stun_server::handle_packets(std::vector<stun_datagram>* datagrams) const
+	{
+		std::string response;
+
+		auto answered = datagrams->begin();
+		for (auto& datagram : *datagrams)
+		{
+			if (!this->handle_packet(datagram.data, datagram.client, datagram.source, &response)) continue;
+
+			answered->client = datagram.client;
+			answered->source = datagram.source;
+			answered->data.swap(response);
+			++answered;
 		}
 
-		return len;
+		datagrams->erase(answered, datagrams->end());
 	}
 }
@@ -1,21 +1,36 @@
 #pragma once
+#include "nat_simulator.hpp"
 
 namespace demonware
 {
+	// A packet exchanged with a STUN client, identified by a key unique per socket
+	struct stun_datagram
+	{
+		uint64_t client;
+		endpoint source;
+		std::string data;
+	};
+
 	class stun_server final
 	{
 	public:
-		explicit stun_server(std::string name);
+		stun_server(std::string name, nat_simulator* nat);
 
 		unsigned long get_address() const;
 
-		int send(SOCKET s, const char* buf, int len, const sockaddr* to, int tolen) const;
+		// Returns false if the packet doesn't need an answer or the NAT drops it
+		bool handle_packet(const std::string_view& data, uint64_t client, const endpoint& source,
+		                   std::string* response) const;
+
+		// Replaces each datagram's data with its answer, removing those without one
+		void handle_packets(std::vector<stun_datagram>* datagrams) const;
 
 	private:
 		std::string name_;
 		unsigned long address_;
+		nat_simulator* nat_;
 
-		void ip_discovery(SOCKET s, const sockaddr* to, int tolen) const;
-		void nat_discovery(SOCKET s, const sockaddr* to, int tolen) const;
+		std::string ip_discovery(const endpoint& external) const;
+		std::string nat_discovery(const endpoint& external) const;
 	};
 }
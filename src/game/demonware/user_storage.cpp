@@ -0,0 +1,566 @@
+#include <std_include.hpp>
+#include "user_storage.hpp"
+
+#include "utils/compression.hpp"
+#include "utils/cryptography.hpp"
+#include "utils/io.hpp"
+#include "utils/thread.hpp"
+
+namespace demonware
+{
+	namespace
+	{
+		constexpr auto temporary_extension = ".tmp";
+
+		// A crash or short write leaves either the old or the new file behind, never a truncated one
+		bool write_file_atomic(const std::string& path, const std::string& data)
+		{
+			const auto temporary = path + temporary_extension;
+			if (!utils::io::write_file(temporary, data)) return false;
+
+			std::error_code error;
+			std::filesystem::rename(temporary, path, error);
+			if (!error) return true;
+
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+
+	user_storage::user_storage(std::string directory, const size_t max_size,
+	                           const std::chrono::milliseconds flush_interval)
+		: directory_(std::move(directory)), blob_directory_(this->directory_ + ".blobs"), max_size_(max_size),
+		  flush_interval_(flush_interval)
+	{
+		const auto index_loaded = this->load_index();
+		this->load_blobs(index_loaded);
+
+		this->flush_thread_ = utils::thread::create_named_thread("DW Storage", [this]()
+		{
+			this->flush_loop();
+		});
+	}
+
+	user_storage::~user_storage()
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->stopped_ = true;
+		}
+
+		this->flush_signal_.notify_all();
+
+		if (this->flush_thread_.joinable())
+		{
+			this->flush_thread_.join();
+		}
+
+		this->write_dirty_files();
+	}
+
+	bool user_storage::try_read(const std::string& id, std::string* data, file_info* info)
+	{
+		std::lock_guard _(this->mutex_);
+		if (!this->find(id, data, info)) return false;
+
+		++this->hits_;
+		return true;
+	}
+
+	bool user_storage::read(const std::string& id, std::string* data, file_info* info)
+	{
+		if (this->try_read(id, data, info)) return true;
+
+		std::lock_guard io(this->io_mutex_);
+
+		std::string hash;
+
+		{
+			std::lock_guard _(this->mutex_);
+			if (this->find(id, data, info))
+			{
+				++this->hits_;
+				return true;
+			}
+
+			++this->misses_;
+
+			if (const auto* file = this->index_.find(id))
+			{
+				hash = file->hash;
+			}
+		}
+
+		std::string buffer;
+		if (!hash.empty())
+		{
+			std::string compressed;
+			if (!utils::io::read_file(this->get_blob_path(hash), &compressed)) return false;
+
+			buffer = utils::compression::zstd::decompress(compressed);
+			if (utils::cryptography::sha256::compute(buffer, true) != hash)
+			{
+				printf("DW: Corrupted blob %s for user file %s\n", hash.data(), id.data());
+				return false;
+			}
+		}
+		else if (!utils::io::read_file(this->get_path(id), &buffer))
+		{
+			return false;
+		}
+
+		std::lock_guard _(this->mutex_);
+
+		// A write might have raced the disk read, that one is newer
+		if (this->find(id, data, info)) return true;
+
+		if (!this->index_.find(id))
+		{
+			file_info loaded{};
+			loaded.file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(id).data());
+			loaded.filename = id;
+			loaded.size = uint32_t(buffer.size());
+
+			this->index_.update(id, loaded);
+			this->index_dirty_ = true;
+		}
+
+		// Filled before caching, a full cache may evict the entry again right away
+		if (data) *data = buffer;
+		if (info && !this->get_info(id, info)) *info = {};
+
+		// Flat files are moved into the store with the next flush
+		this->insert(id, std::move(buffer), hash.empty());
+		return true;
+	}
+
+	bool user_storage::stat(const std::string& id, file_info* info) const
+	{
+		std::lock_guard _(this->mutex_);
+		return this->get_info(id, info);
+	}
+
+	std::vector<user_storage::file_info> user_storage::list(const query& query) const
+	{
+		std::lock_guard _(this->mutex_);
+		return this->index_.list(query);
+	}
+
+	user_storage::file_info user_storage::write(const std::string& id, std::string data, const uint64_t file_id,
+	                                            const std::string& filename, const uint64_t owner, const bool priv)
+	{
+		std::lock_guard _(this->mutex_);
+
+		file_info info{};
+		info.file_id = file_id;
+		info.filename = filename;
+		info.owner = owner;
+		info.priv = priv;
+		info.modified_time = uint32_t(time(nullptr));
+		info.create_time = info.modified_time;
+		info.size = uint32_t(data.size());
+
+		if (const auto* existing = this->index_.find(id))
+		{
+			if (existing->create_time) info.create_time = existing->create_time;
+			if (info.filename.empty()) info.filename = existing->filename;
+
+			// Keeps pointing at the last flushed contents until the next flush
+			info.hash = existing->hash;
+		}
+
+		if (info.filename.empty())
+		{
+			info.filename = id;
+		}
+
+		this->index_.update(id, info);
+		this->index_dirty_ = true;
+
+		this->insert(id, std::move(data), true);
+		return info;
+	}
+
+	void user_storage::flush()
+	{
+		this->write_dirty_files();
+	}
+
+	void user_storage::set_flush_interval(const std::chrono::milliseconds interval)
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->flush_interval_ = std::max(interval, 1ms);
+		}
+
+		this->flush_signal_.notify_all();
+	}
+
+	std::chrono::milliseconds user_storage::get_flush_interval() const
+	{
+		std::lock_guard _(this->mutex_);
+		return this->flush_interval_;
+	}
+
+	user_storage::statistics user_storage::get_statistics() const
+	{
+		std::lock_guard _(this->mutex_);
+
+		statistics stats{};
+		this->index_.for_each([&stats](const std::string&, const file_info& file)
+		{
+			stats.indexed_bytes += file.size;
+		});
+
+		stats.blobs = this->blob_count_;
+		stats.blob_bytes = this->blob_bytes_;
+		stats.hits = this->hits_;
+		stats.misses = this->misses_;
+		stats.files = this->entries_.size();
+		stats.cached_bytes = this->cached_bytes_;
+		stats.dirty_files = this->dirty_files_;
+		stats.dirty_bytes = this->dirty_bytes_;
+		stats.indexed_files = this->index_.size();
+
+		return stats;
+	}
+
+	std::string user_storage::get_path(const std::string& id) const
+	{
+		return this->directory_ + "/" + id;
+	}
+
+	std::string user_storage::get_index_path() const
+	{
+		return this->directory_ + ".index";
+	}
+
+	std::string user_storage::get_blob_path(const std::string& hash) const
+	{
+		return this->blob_directory_ + "/" + hash.substr(0, 2) + "/" + hash;
+	}
+
+	std::string user_storage::get_orphan_directory() const
+	{
+		return this->directory_ + ".orphaned";
+	}
+
+	bool user_storage::load_index()
+	{
+		std::string data;
+		if (utils::io::read_file(this->get_index_path(), &data))
+		{
+			if (this->index_.deserialize(data)) return true;
+
+			// Kept for manual recovery, the rebuilt index is written over it with the next flush
+			printf("DW: User file index is corrupted, rebuilding it from the flat files\n");
+
+			std::error_code error;
+			std::filesystem::rename(this->get_index_path(), this->get_index_path() + ".corrupted", error);
+		}
+
+		// Files stored before the index existed only have their size to go by
+		this->index_.clear();
+		if (!utils::io::directory_exists(this->directory_)) return false;
+
+		std::vector<std::pair<std::string, file_info>> files;
+		for (const auto& path : utils::io::list_files(this->directory_))
+		{
+			if (!std::filesystem::is_regular_file(path)) continue;
+
+			const auto id = path.substr(path.find_last_of('/') + 1);
+
+			file_info info{};
+			info.filename = id;
+			info.size = uint32_t(utils::io::file_size(path));
+
+			// Legacy files are stored under their id
+			char* end{};
+			info.file_id = std::strtoull(id.data(), &end, 16);
+			if (id.empty() || *end)
+			{
+				info.file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(id).data());
+			}
+
+			files.emplace_back(id, std::move(info));
+		}
+
+		this->index_.assign(std::move(files));
+		this->index_dirty_ = true;
+
+		return false;
+	}
+
+	void user_storage::load_blobs(const bool index_loaded)
+	{
+		if (!utils::io::directory_exists(this->blob_directory_)) return;
+
+		std::unordered_map<std::string, size_t> referenced;
+		this->index_.for_each([&referenced](const std::string&, const file_info& file)
+		{
+			if (!file.hash.empty()) referenced[file.hash] = 0;
+		});
+
+		std::vector<std::filesystem::path> orphans;
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(this->blob_directory_, error))
+		{
+			if (!entry.is_regular_file()) continue;
+
+			// Never renamed into place, so nothing can reference it
+			if (entry.path().extension() == temporary_extension)
+			{
+				orphans.push_back(entry.path());
+				continue;
+			}
+
+			const auto hash = entry.path().filename().generic_string();
+			if (referenced.contains(hash))
+			{
+				const auto size = size_t(entry.file_size());
+				this->blobs_[hash] = size;
+
+				++this->blob_count_;
+				this->blob_bytes_ += size;
+			}
+			else
+			{
+				orphans.push_back(entry.path());
+			}
+		}
+
+		for (const auto& path : orphans)
+		{
+			// Blobs are written before the index, so with an intact index anything it does not know about
+			// was left behind by an overwrite or an interrupted flush
+			if (index_loaded || path.extension() == temporary_extension)
+			{
+				std::filesystem::remove(path, error);
+				continue;
+			}
+
+			// A rebuilt index doesn't know any blob, they are the only copy of the migrated files
+			const auto target = std::filesystem::path(this->get_orphan_directory()) / path.filename();
+			std::filesystem::create_directories(target.parent_path(), error);
+			std::filesystem::rename(path, target, error);
+		}
+
+		if (!index_loaded && !orphans.empty())
+		{
+			printf("DW: User file index was rebuilt, moved %zu unreferenced blobs to %s\n", orphans.size(),
+			       this->get_orphan_directory().data());
+		}
+	}
+
+	bool user_storage::get_info(const std::string& id, file_info* info) const
+	{
+		const auto* file = this->index_.find(id);
+		if (!file) return false;
+
+		if (info) *info = *file;
+		return true;
+	}
+
+	bool user_storage::find(const std::string& id, std::string* data, file_info* info)
+	{
+		const auto entry = this->entries_.find(id);
+		if (entry == this->entries_.end()) return false;
+
+		this->lru_.splice(this->lru_.begin(), this->lru_, entry->second.position);
+
+		if (data) *data = entry->second.data;
+		if (info && !this->get_info(id, info)) *info = {};
+
+		return true;
+	}
+
+	void user_storage::insert(const std::string& id, std::string data, const bool dirty)
+	{
+		auto entry = this->entries_.find(id);
+		if (entry == this->entries_.end())
+		{
+			this->lru_.push_front(id);
+			entry = this->entries_.emplace(id, user_storage::entry{{}, false, this->lru_.begin(), 0}).first;
+		}
+		else
+		{
+			this->lru_.splice(this->lru_.begin(), this->lru_, entry->second.position);
+			this->cached_bytes_ -= entry->second.data.size();
+
+			if (entry->second.dirty)
+			{
+				this->dirty_bytes_ -= entry->second.data.size();
+				--this->dirty_files_;
+			}
+		}
+
+		entry->second.data = std::move(data);
+		entry->second.dirty = dirty;
+		++entry->second.version;
+
+		this->cached_bytes_ += entry->second.data.size();
+
+		if (dirty)
+		{
+			this->dirty_bytes_ += entry->second.data.size();
+			++this->dirty_files_;
+		}
+
+		this->evict();
+	}
+
+	void user_storage::evict()
+	{
+		// Dirty files stay until they have been flushed
+		auto position = this->lru_.end();
+		while (this->cached_bytes_ > this->max_size_ && position != this->lru_.begin())
+		{
+			--position;
+
+			const auto entry = this->entries_.find(*position);
+			if (entry->second.dirty) continue;
+
+			this->cached_bytes_ -= entry->second.data.size();
+			this->entries_.erase(entry);
+			position = this->lru_.erase(position);
+		}
+
+		if (this->dirty_bytes_ > this->max_size_ / 2 && !this->flush_requested_)
+		{
+			this->flush_requested_ = true;
+			this->flush_signal_.notify_all();
+		}
+	}
+
+	void user_storage::write_dirty_files()
+	{
+		std::lock_guard io(this->io_mutex_);
+
+		struct dirty_file
+		{
+			std::string id;
+			std::string data;
+			uint64_t version;
+			std::string hash;
+		};
+
+		std::vector<dirty_file> files;
+
+		{
+			std::lock_guard _(this->mutex_);
+			if (!this->dirty_files_ && !this->index_dirty_) return;
+
+			files.reserve(this->dirty_files_);
+
+			// Entries stay dirty, and therefore cached, until their blob is on disk
+			for (const auto& entry : this->entries_)
+			{
+				if (!entry.second.dirty) continue;
+				files.push_back({entry.first, entry.second.data, entry.second.version, {}});
+			}
+		}
+
+		// Identical contents hash to the same blob and are only stored once
+		size_t new_blobs = 0;
+		uint64_t new_blob_bytes = 0;
+
+		for (auto& file : files)
+		{
+			auto hash = utils::cryptography::sha256::compute(file.data, true);
+
+			if (!this->blobs_.contains(hash))
+			{
+				const auto compressed = utils::compression::zstd::compress(file.data);
+				if (!write_file_atomic(this->get_blob_path(hash), compressed))
+				{
+					// Retried with the next flush
+					printf("DW: Failed to write user file %s\n", file.id.data());
+					continue;
+				}
+
+				this->blobs_[hash] = compressed.size();
+
+				++new_blobs;
+				new_blob_bytes += compressed.size();
+			}
+
+			file.hash = std::move(hash);
+		}
+
+		std::string index;
+		std::vector<std::string> migrated;
+
+		{
+			std::lock_guard _(this->mutex_);
+
+			for (const auto& file : files)
+			{
+				if (file.hash.empty()) continue;
+
+				// Written again in the meantime, the newer data still has to be flushed
+				const auto entry = this->entries_.find(file.id);
+				if (entry != this->entries_.end() && entry->second.dirty && entry->second.version == file.version)
+				{
+					entry->second.dirty = false;
+					this->dirty_bytes_ -= entry->second.data.size();
+					--this->dirty_files_;
+				}
+
+				const auto* info = this->index_.find(file.id);
+				if (!info) continue;
+
+				if (info->hash.empty()) migrated.push_back(file.id);
+				this->index_.set_hash(file.id, file.hash);
+				this->index_dirty_ = true;
+			}
+
+			this->blob_count_ += new_blobs;
+			this->blob_bytes_ += new_blob_bytes;
+
+			if (this->index_dirty_)
+			{
+				index = this->index_.serialize();
+				this->index_dirty_ = false;
+			}
+
+			this->evict();
+		}
+
+		// Written after the blobs so it never references contents that are not on disk yet
+		if (!index.empty() && !write_file_atomic(this->get_index_path(), index))
+		{
+			printf("DW: Failed to write user file index\n");
+
+			std::lock_guard _(this->mutex_);
+			this->index_dirty_ = true;
+			return;
+		}
+
+		// The flat copies are only dropped once the index on disk points at their blob
+		std::error_code error;
+		for (const auto& id : migrated)
+		{
+			std::filesystem::remove(this->get_path(id), error);
+		}
+	}
+
+	void user_storage::flush_loop()
+	{
+		std::unique_lock lock(this->mutex_);
+
+		while (!this->stopped_)
+		{
+			this->flush_signal_.wait_for(lock, this->flush_interval_, [this]()
+			{
+				return this->stopped_ || this->flush_requested_;
+			});
+
+			this->flush_requested_ = false;
+
+			lock.unlock();
+			this->write_dirty_files();
+			lock.lock();
+		}
+	}
+}
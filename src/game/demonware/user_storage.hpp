@@ -0,0 +1,114 @@
+#pragma once
+#include "file_index.hpp"
+
+namespace demonware
+{
+	// Size-bounded LRU cache in front of a content-addressed file store.
+	// Writes only touch the cache and are flushed to disk by a background thread.
+	// Contents are stored as zstd compressed blobs named by their SHA-256,
+	// the index maps every file to its blob and holds its metadata.
+	// Files from the old flat layout are moved into the store when first read.
+	class user_storage final
+	{
+	public:
+		using file_info = file_index::file_info;
+		using query = file_index::query;
+
+		struct statistics
+		{
+			uint64_t hits;
+			uint64_t misses;
+			size_t files;
+			size_t cached_bytes;
+			size_t dirty_files;
+			size_t dirty_bytes;
+			size_t indexed_files;
+			uint64_t indexed_bytes;
+			size_t blobs;
+			uint64_t blob_bytes;
+		};
+
+		user_storage(std::string directory, size_t max_size, std::chrono::milliseconds flush_interval);
+		~user_storage();
+
+		user_storage(user_storage&&) = delete;
+		user_storage(const user_storage&) = delete;
+		user_storage& operator=(user_storage&&) = delete;
+		user_storage& operator=(const user_storage&) = delete;
+
+		// Only looks at the cache, never blocks on the disk
+		bool try_read(const std::string& id, std::string* data, file_info* info = nullptr);
+		bool read(const std::string& id, std::string* data, file_info* info = nullptr);
+		bool stat(const std::string& id, file_info* info) const;
+		std::vector<file_info> list(const query& query) const;
+
+		// An empty filename keeps the name the file was stored with
+		file_info write(const std::string& id, std::string data, uint64_t file_id, const std::string& filename,
+		                uint64_t owner, bool priv);
+
+		void flush();
+
+		void set_flush_interval(std::chrono::milliseconds interval);
+		std::chrono::milliseconds get_flush_interval() const;
+
+		statistics get_statistics() const;
+
+	private:
+		struct entry
+		{
+			std::string data;
+			bool dirty;
+			std::list<std::string>::iterator position;
+
+			// Bumped on every write, a flush only marks the entry clean if it wrote the latest data
+			uint64_t version;
+		};
+
+		std::string directory_;
+		std::string blob_directory_;
+		size_t max_size_;
+
+		// Held across disk access so reads never see a file that is halfway through being flushed.
+		// Always acquired before mutex_, also guards blobs_.
+		std::mutex io_mutex_;
+		std::unordered_map<std::string, size_t> blobs_;
+
+		mutable std::mutex mutex_;
+		std::condition_variable flush_signal_;
+		std::chrono::milliseconds flush_interval_;
+		bool stopped_ = false;
+		bool flush_requested_ = false;
+
+		file_index index_;
+		bool index_dirty_ = false;
+
+		std::unordered_map<std::string, entry> entries_;
+		std::list<std::string> lru_;
+		size_t cached_bytes_ = 0;
+		size_t dirty_bytes_ = 0;
+		size_t dirty_files_ = 0;
+		uint64_t hits_ = 0;
+		uint64_t misses_ = 0;
+		size_t blob_count_ = 0;
+		uint64_t blob_bytes_ = 0;
+
+		std::thread flush_thread_;
+
+		std::string get_path(const std::string& id) const;
+		std::string get_index_path() const;
+		std::string get_blob_path(const std::string& hash) const;
+		std::string get_orphan_directory() const;
+
+		// Returns false if the index had to be rebuilt from the flat layout
+		bool load_index();
+		void load_blobs(bool index_loaded);
+		bool get_info(const std::string& id, file_info* info) const;
+
+		bool find(const std::string& id, std::string* data, file_info* info);
+		void insert(const std::string& id, std::string data, bool dirty);
+		void evict();
+
+		void write_dirty_files();
+		void flush_loop();
+	};
+}
@@ -3,17 +3,10 @@
 
 #include <utils/hook.hpp>
 #include <utils/nt.hpp>
-#include <utils/cryptography.hpp>
-
-#include "game/demonware/services/bdLSGHello.hpp"       // 7
-#include "game/demonware/services/bdStorage.hpp"        // 10
-#include "game/demonware/services/bdDediAuth.hpp"       // 12
-#include "game/demonware/services/bdTitleUtilities.hpp" // 12
-#include "game/demonware/services/bdDML.hpp"            // 27
-#include "game/demonware/services/bdDediRSAAuth.hpp"    // 26
-#include "game/demonware/services/bdSteamAuth.hpp"      // 28
 
 #include "dw.hpp"
+#include "command.hpp"
+#include "console.hpp"
 
 namespace demonware
 {
@@ -25,7 +18,19 @@ namespace demonware
 			{
 				const auto in_addr = reinterpret_cast<const sockaddr_in*>(to);
 				const auto server = dw::find_stun_server_by_address(in_addr->sin_addr.s_addr);
-				if (server) return server->send(s, buf, len, to, tolen);
+				if (server)
+				{
+					// Without NAT simulation the game sees itself at the loopback address
+					const endpoint source{htonl(INADDR_LOOPBACK), 3074};
+
+					std::string response;
+					if (server->handle_packet(std::string_view(buf, len), s, source, &response))
+					{
+						dw::send_datagram_packet(s, response, to, tolen);
+					}
+
+					return len;
+				}
 			}
 
 			return sendto(s, buf, len, flags, to, tolen);
@@ -43,33 +48,39 @@ namespace demonware
 
 		int WINAPI send(const SOCKET s, const char* buf, const int len, const int flags)
 		{
-			auto server = dw::find_server_by_socket(s);
-			if (server) return server->send(buf, len);
+			auto session = dw::find_session_by_socket(s);
+			if (session) return dw::send_session_data(session, buf, len);
 
 			return ::send(s, buf, len, flags);
 		}
 
 		int WINAPI recv(const SOCKET s, char* buf, const int len, const int flags)
 		{
-			auto server = dw::find_server_by_socket(s);
-			if (server)
+			auto session = dw::find_session_by_socket(s);
+			if (session)
 			{
 				const auto blocking = dw::is_blocking_socket(s, TCP_BLOCKING);
 
-				int result;
-				do
+				while (true)
 				{
-					result = server->recv(buf, len);
-					if (blocking && result < 0) std::this_thread::sleep_for(1ms);
+					const auto result = session->recv(buf, len);
+					if (result >= 0) return result;
+
+					if (!blocking)
+					{
+						WSASetLastError(WSAEWOULDBLOCK);
+						return result;
+					}
+
+					// Nothing will ever arrive once the socket was unlinked or the core shut down
+					if (dw::find_session_by_socket(s) != session)
+					{
+						WSASetLastError(WSAENOTSOCK);
+						return SOCKET_ERROR;
+					}
+
+					std::this_thread::sleep_for(1ms);
 				}
-				while (blocking && result < 0);
-
-				if (!blocking && result < 0)
-				{
-					WSASetLastError(WSAEWOULDBLOCK);
-				}
-
-				return result;
 			}
 
 			return ::recv(s, buf, len, flags);
@@ -157,245 +168,278 @@ namespace demonware
 
 namespace demonware
 {
-	bool dw::terminate_;
-	std::thread dw::message_thread_;
-	std::recursive_mutex dw::server_mutex_;
-	std::map<SOCKET, bool> dw::blocking_sockets_;
-	std::map<SOCKET, std::shared_ptr<service_server>> dw::socket_links_;
-	std::map<unsigned long, std::shared_ptr<service_server>> dw::servers_;
-	std::map<unsigned long, std::shared_ptr<stun_server>> dw::stun_servers_;
-	std::map<SOCKET, std::queue<std::pair<std::string, std::string>>> dw::datagram_packets_;
-
-	uint8_t dw::encryption_key_[24];
-	uint8_t dw::decryption_key_[24];
+	std::shared_mutex dw::core_mutex_;
+	std::unique_ptr<core> dw::core_;
+
+	utils::concurrency::counting_filter<> dw::linked_sockets_;
+	utils::concurrency::counting_filter<> dw::stun_addresses_;
+
+	utils::concurrency::sharded_map<SOCKET, dw::socket_link> dw::socket_links_;
+	utils::concurrency::sharded_map<SOCKET, bool> dw::blocking_sockets_;
 
 	std::shared_ptr<service_server> dw::find_server_by_name(const std::string& name)
 	{
-		std::lock_guard _(server_mutex_);
-		return find_server_by_address(utils::cryptography::jenkins_one_at_a_time::compute(name));
+		std::shared_lock _(core_mutex_);
+		if (!core_) return {};
+		return core_->find_server_by_name(name);
 	}
 
-	std::shared_ptr<service_server> dw::find_server_by_address(const unsigned long address)
+	std::shared_ptr<stun_server> dw::find_stun_server_by_name(const std::string& name)
 	{
-		std::lock_guard _(server_mutex_);
-
-		const auto server = servers_.find(address);
-		if (server != servers_.end())
-		{
-			return server->second;
-		}
-
-		return {};
+		std::shared_lock _(core_mutex_);
+		if (!core_) return {};
+		return core_->find_stun_server_by_name(name);
 	}
 
-	std::shared_ptr<stun_server> dw::find_stun_server_by_name(const std::string& name)
+	std::shared_ptr<stun_server> dw::find_stun_server_by_address(const unsigned long address)
 	{
-		std::lock_guard _(server_mutex_);
-		return find_stun_server_by_address(utils::cryptography::jenkins_one_at_a_time::compute(name));
+		if (!stun_addresses_.may_contain(address)) return {};
+
+		std::shared_lock _(core_mutex_);
+		if (!core_) return {};
+		return core_->find_stun_server_by_address(address);
 	}
 
-	std::shared_ptr<stun_server> dw::find_stun_server_by_address(const unsigned long address)
+	std::shared_ptr<service_session> dw::find_session_by_socket(const SOCKET s)
 	{
-		std::lock_guard _(server_mutex_);
+		if (!linked_sockets_.may_contain(s)) return {};
 
-		const auto server = stun_servers_.find(address);
-		if (server != stun_servers_.end())
-		{
-			return server->second;
-		}
+		const auto link = socket_links_.find(s);
+		if (!link) return {};
 
-		return {};
+		return link->session;
 	}
 
-	std::shared_ptr<service_server> dw::find_server_by_socket(const SOCKET s)
+	int dw::send_session_data(const std::shared_ptr<service_session>& session, const char* buf, const int len)
 	{
-		std::lock_guard _(server_mutex_);
-
-		const auto server = socket_links_.find(s);
-		if (server != socket_links_.end())
+		// Sessions hand their work to the core, which is gone after pre_destroy
+		std::shared_lock _(core_mutex_);
+		if (!core_)
 		{
-			return server->second;
+			WSASetLastError(WSAENETDOWN);
+			return SOCKET_ERROR;
 		}
 
-		return {};
+		return session->send(buf, len);
 	}
 
 	bool dw::link_socket(const SOCKET s, const unsigned long address)
 	{
-		std::lock_guard _(server_mutex_);
+		std::shared_lock _(core_mutex_);
+		if (!core_) return false;
 
-		const auto server = find_server_by_address(address);
+		const auto server = core_->find_server_by_address(address);
 		if (!server) return false;
 
-		socket_links_[s] = server;
+		auto session = server->create_session();
+		const auto created = socket_links_.access(s, [&session](socket_link& link)
+		{
+			link.session = std::move(session);
+		});
+
+		if (created) linked_sockets_.add(s);
 		return true;
 	}
 
 	void dw::unlink_socket(const SOCKET sock)
 	{
-		std::lock_guard _(server_mutex_);
+		if (!linked_sockets_.may_contain(sock) || !socket_links_.erase(sock)) return;
+		linked_sockets_.remove(sock);
 
-		const auto server = socket_links_.find(sock);
-		if (server != socket_links_.end())
-		{
-			socket_links_.erase(server);
-		}
+		// The next socket with this handle is another virtual client
+		std::shared_lock _(core_mutex_);
+		if (core_) core_->get_nat().release(sock);
+	}
 
-		const auto dgram_packets = datagram_packets_.find(sock);
-		if (dgram_packets != datagram_packets_.end())
-		{
-			datagram_packets_.erase(dgram_packets);
-		}
+	std::shared_ptr<dw::datagram_queue> dw::find_datagram_queue(const SOCKET s)
+	{
+		if (!linked_sockets_.may_contain(s)) return {};
+
+		const auto link = socket_links_.find(s);
+		if (!link) return {};
+
+		return link->datagrams;
 	}
 
 	int dw::recv_datagam_packet(const SOCKET s, char* buf, const int len, sockaddr* from, int* fromlen)
 	{
-		std::unique_lock lock(server_mutex_);
+		const auto queue = find_datagram_queue(s);
+		if (!queue) return 0;
 
-		auto queue = datagram_packets_.find(s);
-		if (queue != datagram_packets_.end())
-		{
-			const auto blocking = is_blocking_socket(s, UDP_BLOCKING);
+		const auto blocking = is_blocking_socket(s, UDP_BLOCKING);
 
-			lock.unlock();
-			while (blocking && queue->second.empty())
+		// The game reads each socket from a single thread, which makes it the queue's only consumer
+		std::pair<std::string, std::string> packet;
+		while (!queue->try_pop(&packet))
+		{
+			if (!blocking)
 			{
-				std::this_thread::sleep_for(1ms);
+				WSASetLastError(WSAEWOULDBLOCK);
+				return -1;
 			}
-			lock.lock();
 
-			if (!queue->second.empty())
+			if (find_datagram_queue(s) != queue)
 			{
-				auto packet = queue->second.front();
-				queue->second.pop();
-
-				*fromlen = INT(packet.first.size());
-				std::memcpy(from, packet.first.data(), *fromlen);
-
-				const int size = std::min(len, INT(packet.second.size()));
-				std::memcpy(buf, packet.second.data(), size);
-
-				return size;
+				WSASetLastError(WSAENOTSOCK);
+				return -1;
 			}
 
-			WSASetLastError(WSAEWOULDBLOCK);
-			return -1;
+			std::this_thread::sleep_for(1ms);
 		}
 
-		return 0;
+		*fromlen = INT(packet.first.size());
+		std::memcpy(from, packet.first.data(), *fromlen);
+
+		const int size = std::min(len, INT(packet.second.size()));
+		std::memcpy(buf, packet.second.data(), size);
+
+		return size;
 	}
 
 	void dw::send_datagram_packet(const SOCKET s, const std::string& data, const sockaddr* to, const int tolen)
 	{
-		std::lock_guard _(server_mutex_);
-		datagram_packets_[s].push({std::string(LPSTR(to), tolen), data});
+		auto queue = find_datagram_queue(s);
+		if (!queue)
+		{
+			const auto created = socket_links_.access(s, [&queue](socket_link& link)
+			{
+				if (!link.datagrams) link.datagrams = std::make_shared<datagram_queue>();
+				queue = link.datagrams;
+			});
+
+			if (created) linked_sockets_.add(s);
+		}
+
+		queue->push({std::string(LPSTR(to), tolen), data});
 	}
 
 	bool dw::is_blocking_socket(const SOCKET s, const bool def)
 	{
-		std::lock_guard _(server_mutex_);
-
-		if (blocking_sockets_.find(s) != blocking_sockets_.end())
-		{
-			return blocking_sockets_[s];
-		}
-
-		return def;
+		return blocking_sockets_.find(s).value_or(def);
 	}
 
 	void dw::remove_blocking_socket(const SOCKET s)
 	{
-		std::lock_guard _(server_mutex_);
-
-		const auto entry = blocking_sockets_.find(s);
-		if (entry != blocking_sockets_.end())
-		{
-			blocking_sockets_.erase(entry);
-		}
+		blocking_sockets_.erase(s);
 	}
 
 	void dw::set_blocking_socket(const SOCKET s, const bool blocking)
 	{
-		std::lock_guard _(server_mutex_);
-		blocking_sockets_[s] = blocking;
+		blocking_sockets_.access(s, [blocking](bool& entry)
+		{
+			entry = blocking;
+		});
 	}
 
-	uint8_t* dw::get_key(const bool encrypt)
+	void dw::pre_destroy()
 	{
-		return encrypt ? encryption_key_ : decryption_key_;
-	}
+		std::unique_ptr<core> backend;
 
-	void dw::set_key(const bool encrypt, uint8_t* key)
-	{
-		static_assert(sizeof encryption_key_ == sizeof decryption_key_);
-		std::memcpy(encrypt ? encryption_key_ : decryption_key_, key, sizeof encryption_key_);
+		// Stale filter counts only cost an extra lookup
+		socket_links_.clear();
+		blocking_sockets_.clear();
+
+		{
+			std::lock_guard _(core_mutex_);
+			backend = std::move(core_);
+		}
+
+		// Drains the workers and writes everything still pending to disk
+		backend.reset();
 	}
 
-	void dw::server_thread()
+	void dw::post_load()
 	{
-		terminate_ = false;
-		while (!terminate_)
+		core::settings settings;
+		settings.worker_count = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+
+		// Instances on one machine draw their synthetic addresses from different /16 ranges
+		settings.nat_first_address = 0x0A000001 | (((GetCurrentProcessId() >> 2) & 0xFF) << 16);
+
 		{
-			std::unique_lock lock(server_mutex_);
+			std::lock_guard _(core_mutex_);
+			core_ = std::make_unique<core>(settings);
+			core_->register_default_servers();
 
-			for (auto& server : servers_)
+			for (const auto& server : core_->get_stun_servers())
 			{
-				server.second->run_frame();
+				stun_addresses_.add(server->get_address());
 			}
+		}
 
-			lock.unlock();
+		command::add("dw_stats", []()
+		{
+			with_core([](core& backend)
+			{
+				backend.dump_statistics([](const char* line)
+				{
+					console::info("%s", line);
+				});
+			});
+		});
 
-			std::this_thread::sleep_for(50ms);
-		}
-	}
+		// Simulates a slow disk for storage requests
+		command::add("dw_io_latency", [](const command::params& params)
+		{
+			with_core([&params](core& backend)
+			{
+				if (params.size() < 2)
+				{
+					console::info("DW I/O latency: %d ms\n", backend.get_io_latency());
+					return;
+				}
 
-	void dw::pre_destroy()
-	{
-		std::lock_guard _(server_mutex_);
+				backend.set_io_latency(std::atoi(params.get(1)));
+			});
+		});
 
-		terminate_ = true;
-		if (message_thread_.joinable())
+		command::add("dw_flush_interval", [](const command::params& params)
 		{
-			message_thread_.join();
-		}
+			with_core([&params](core& backend)
+			{
+				auto& storage = backend.get_user_storage();
 
-		servers_.clear();
-		stun_servers_.clear();
-		socket_links_.clear();
-		blocking_sockets_.clear();
-		datagram_packets_.clear();
-	}
+				if (params.size() < 2)
+				{
+					console::info("DW storage flush interval: %lld ms\n", storage.get_flush_interval().count());
+					return;
+				}
 
-	dw::dw()
-	{
-		register_stun_server("mw3-stun.us.demonware.net");
-		register_stun_server("mw3-stun.eu.demonware.net");
-		register_stun_server("stun.jp.demonware.net");
-		register_stun_server("stun.au.demonware.net");
-		register_stun_server("stun.eu.demonware.net");
-		register_stun_server("stun.us.demonware.net");
-
-		auto lsg_server = register_server("mw3-pc-lobby.prod.demonware.net");
-		auto auth_server = register_server("mw3-pc-auth.prod.demonware.net");
-
-		auth_server->register_service<bdDediAuth>();
-		auth_server->register_service<bdSteamAuth>();
-		auth_server->register_service<bdDediRSAAuth>();
-
-		lsg_server->register_service<bdLSGHello>();
-		lsg_server->register_service<bdStorage>();
-		lsg_server->register_service<bdTitleUtilities>();
-		lsg_server->register_service<bdDML>();
-		/*lsg_server->register_service<bdMatchMaking>();
-		lsg_server->register_service<bdBandwidthTest>();
-		lsg_server->register_service<bdGroup>();
-		lsg_server->register_service<bdAnticheat>();
-		lsg_server->register_service<bdRelayService>();*/
-	}
+				storage.set_flush_interval(std::chrono::milliseconds(std::atoi(params.get(1))));
+			});
+		});
 
-	void dw::post_load()
-	{
-		message_thread_ = std::thread(server_thread);
+		command::add("dw_nat_type", [](const command::params& params)
+		{
+			with_core([&params](core& backend)
+			{
+				auto& nat = backend.get_nat();
+
+				if (params.size() < 2)
+				{
+					console::info("DW NAT type: %s (none, open, moderate, strict)\n",
+					              nat_simulator::get_type_name(nat.get_type()));
+					return;
+				}
+
+				const auto type = nat_simulator::parse_type(params.get(1));
+				if (!type)
+				{
+					console::info("Unknown NAT type %s\n", params.get(1));
+					return;
+				}
+
+				nat.set_type(*type);
+			});
+		});
+
+		command::add("dw_flush", []()
+		{
+			with_core([](core& backend)
+			{
+				backend.get_user_storage().flush();
+			});
+		});
 
 		io::register_hook("send", io::send);
 		io::register_hook("recv", io::recv);
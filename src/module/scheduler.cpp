@@ -5,92 +5,420 @@
 #include <utils/hook.hpp>
 #include <utils/thread.hpp>
 #include <utils/concurrency.hpp>
+#include <utils/work_stealing_pool.hpp>
 
 #include "scheduler.hpp"
+#include "command.hpp"
+#include "console.hpp"
 
 namespace
 {
-	constexpr bool cond_continue = false;
-	constexpr bool cond_end = true;
-
+	// A queued call of a task
 	struct task
 	{
-		std::function<bool()> handler{};
-		std::chrono::milliseconds interval{};
-		std::chrono::high_resolution_clock::time_point last_call{};
+		std::shared_ptr<scheduler::task_state> state{};
+		std::chrono::high_resolution_clock::time_point next_call{};
+		uint64_t sequence{};
+		uint32_t generation{};
+
+		// Frames this call was pushed back because the budget was used up
+		uint32_t deferrals{};
 	};
 
 	using task_list = std::vector<task>;
 
+	// Heap order: the task due first on top, tasks due at the same time in the order they were added
+	bool is_due_later(const task& a, const task& b)
+	{
+		if (a.next_call != b.next_call) return a.next_call > b.next_call;
+		return a.sequence > b.sequence;
+	}
+
+	// Calls left behind by cancel or reschedule are dropped when they come up
+	bool is_current(const task& task)
+	{
+		const auto& state = *task.state;
+		return state.pending && !state.cancelled && state.generation == task.generation;
+	}
+
+	// Runs the task, returns whether it has to be queued again
+	bool run_task(const task& task)
+	{
+		auto& state = *task.state;
+		const auto res = state.run();
+
+		// A reschedule during the call already queued the next one
+		if (state.generation != task.generation) return false;
+
+		if (res == scheduler::cond_end || state.cancelled)
+		{
+			state.pending = false;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Within a frame: high priority first, then the order they became due in
+	bool runs_before(const task& a, const task& b)
+	{
+		if (a.state->level != b.state->level) return a.state->level < b.state->level;
+		if (a.next_call != b.next_call) return a.next_call < b.next_call;
+		return a.sequence < b.sequence;
+	}
+
+	// Calls deferred this often run even when the budget is used up, so low priority work can't starve
+	constexpr uint32_t max_deferrals = 8;
+
+	// Upper bounds of the buckets for the time a frame spent past its budget, the last bucket is open
+	constexpr std::chrono::microseconds overrun_bounds[] = {0us, 500us, 1ms, 2ms, 4ms, 8ms, 16ms};
+
+	struct frame_statistics
+	{
+		std::atomic<uint64_t> frames{};
+		std::atomic<uint64_t> deferred_tasks{};
+		std::array<std::atomic<uint64_t>, std::size(overrun_bounds) + 1> overruns{};
+
+		void record(const std::chrono::microseconds overrun)
+		{
+			size_t bucket = 0;
+			while (bucket < std::size(overrun_bounds) && overrun > overrun_bounds[bucket])
+			{
+				++bucket;
+			}
+
+			++this->overruns[bucket];
+		}
+	};
+
 	class task_pipeline
 	{
 	public:
 		void add(task&& task)
 		{
-			new_callbacks_.access([&task](task_list& tasks)
-			{
-				tasks.emplace_back(std::move(task));
-			});
+			new_callbacks_.push(std::move(task));
 		}
 
-		void execute()
+		// A budget of zero runs every due task
+		void execute(const std::chrono::microseconds budget)
 		{
 			callbacks_.access([&](task_list& tasks)
 			{
 				this->merge_callbacks();
 
-				for (auto i = tasks.begin(); i != tasks.end();)
+				// Only the due tasks are touched, without a budget the clock is read once per frame
+				const auto start = std::chrono::high_resolution_clock::now();
+				auto now = start;
+
+				auto due = std::move(this->due_);
+				due.clear();
+
+				while (!tasks.empty() && tasks.front().next_call <= start)
+				{
+					std::pop_heap(tasks.begin(), tasks.end(), is_due_later);
+					due.emplace_back(std::move(tasks.back()));
+					tasks.pop_back();
+				}
+
+				if (budget.count() > 0)
+				{
+					std::sort(due.begin(), due.end(), runs_before);
+				}
+
+				for (auto& task : due)
 				{
-					const auto now = std::chrono::high_resolution_clock::now();
-					const auto diff = now - i->last_call;
+					if (!is_current(task)) continue;
 
-					if (diff < i->interval)
+					const auto over_budget = budget.count() > 0 && now - start >= budget;
+					if (over_budget && task.state->level != scheduler::priority::high && task.deferrals < max_deferrals)
 					{
-						++i;
+						// Still due, so it comes up first in the next frame
+						++task.deferrals;
+						++this->statistics_.deferred_tasks;
+
+						tasks.emplace_back(std::move(task));
+						std::push_heap(tasks.begin(), tasks.end(), is_due_later);
 						continue;
 					}
 
-					i->last_call = now;
+					const auto again = run_task(task);
+					if (budget.count() > 0) now = std::chrono::high_resolution_clock::now();
+					if (!again) continue;
 
-					const auto res = i->handler();
-					if (res == cond_end)
-					{
-						i = tasks.erase(i);
-					}
-					else
-					{
-						++i;
-					}
+					task.next_call = start + task.state->interval;
+					task.deferrals = 0;
+					tasks.emplace_back(std::move(task));
+					std::push_heap(tasks.begin(), tasks.end(), is_due_later);
+				}
+
+				if (budget.count() > 0)
+				{
+					++this->statistics_.frames;
+					this->statistics_.record(std::chrono::duration_cast<std::chrono::microseconds>(now - start) - budget);
 				}
+
+				// Keeps the capacity around for the next frame
+				due.clear();
+				this->due_ = std::move(due);
 			});
 		}
 
+		const frame_statistics& get_statistics() const
+		{
+			return this->statistics_;
+		}
+
 	private:
-		utils::concurrency::container<task_list> new_callbacks_;
+		frame_statistics statistics_;
+
+		// Filled from any thread, drained by the pipeline's own thread while holding callbacks_
+		utils::concurrency::mpsc_queue<task> new_callbacks_;
 		utils::concurrency::container<task_list, std::recursive_mutex> callbacks_;
 
+		uint64_t next_sequence_ = 0;
+		task_list due_;
+
 		void merge_callbacks()
 		{
 			callbacks_.access([&](task_list& tasks)
 			{
-				new_callbacks_.access([&](task_list& new_tasks)
+				task task;
+				while (new_callbacks_.try_pop(&task))
 				{
-					tasks.insert(tasks.end(), std::move_iterator<task_list::iterator>(new_tasks.begin()), std::move_iterator<task_list::iterator>(new_tasks.end()));
-					new_tasks = {};
-				});
+					task.sequence = this->next_sequence_++;
+					tasks.emplace_back(std::move(task));
+					std::push_heap(tasks.begin(), tasks.end(), is_due_later);
+				}
 			});
 		}
 	};
 
-	volatile bool kill = false;
-	std::thread thread;
+	// Set on a pool worker while it runs an async task
+	thread_local bool in_async_task = false;
+
+	// Hands due tasks to a work-stealing pool instead of running them one after the other
+	class async_pipeline
+	{
+	public:
+		void start()
+		{
+			const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+			this->pool_ = std::make_unique<utils::work_stealing_pool>("Async Scheduler", cores, 2);
+
+			this->thread_ = utils::thread::create_named_thread("Async Timer", [this]()
+			{
+				this->run();
+			});
+		}
+
+		void stop()
+		{
+			{
+				std::lock_guard _(this->mutex_);
+				this->stopped_ = true;
+			}
+
+			this->signal_.notify_all();
+
+			if (this->thread_.joinable())
+			{
+				this->thread_.join();
+			}
+
+			if (this->pool_)
+			{
+				this->pool_->stop();
+			}
+		}
+
+		void add(task&& task)
+		{
+			{
+				std::lock_guard _(this->mutex_);
+				if (this->stopped_) return;
+
+				// A task queueing another call of itself without a delay would otherwise spin a worker
+				if (in_async_task)
+				{
+					task.next_call = std::max(task.next_call, std::chrono::high_resolution_clock::now() + min_interval);
+				}
+
+				task.sequence = this->next_sequence_++;
+				this->tasks_.emplace_back(std::move(task));
+				std::push_heap(this->tasks_.begin(), this->tasks_.end(), is_due_later);
+			}
+
+			this->signal_.notify_one();
+		}
+
+	private:
+		// Repeating tasks used to run once per 10ms tick, keep them from spinning a worker
+		static constexpr std::chrono::milliseconds min_interval = 10ms;
+
+		std::mutex mutex_;
+		std::condition_variable signal_;
+		bool stopped_ = false;
+
+		task_list tasks_;
+		uint64_t next_sequence_ = 0;
+
+		std::thread thread_;
+		std::unique_ptr<utils::work_stealing_pool> pool_;
+
+		void run()
+		{
+			task_list due;
+
+			std::unique_lock lock(this->mutex_);
+			while (!this->stopped_)
+			{
+				if (this->tasks_.empty())
+				{
+					this->signal_.wait(lock);
+					continue;
+				}
+
+				// Wakes up when the first task is due or an earlier one is added
+				const auto next_call = this->tasks_.front().next_call;
+				if (next_call > std::chrono::high_resolution_clock::now())
+				{
+					this->signal_.wait_until(lock, next_call);
+					continue;
+				}
+
+				const auto now = std::chrono::high_resolution_clock::now();
+				while (!this->tasks_.empty() && this->tasks_.front().next_call <= now)
+				{
+					std::pop_heap(this->tasks_.begin(), this->tasks_.end(), is_due_later);
+					due.emplace_back(std::move(this->tasks_.back()));
+					this->tasks_.pop_back();
+				}
+
+				lock.unlock();
+
+				for (auto& task : due)
+				{
+					this->dispatch(std::move(task));
+				}
+
+				due.clear();
+				lock.lock();
+			}
+		}
+
+		void dispatch(task&& task)
+		{
+			if (!is_current(task)) return;
+
+			const auto lane = task.state->type == scheduler::pipeline::background
+				                  ? utils::work_stealing_pool::lane::background
+				                  : utils::work_stealing_pool::lane::normal;
+
+			this->pool_->submit([this, task = std::move(task)]() mutable
+			{
+				auto& state = *task.state;
+
+				{
+					// Cancelled or rescheduled while it waited for a worker
+					std::lock_guard _(state.call_mutex);
+					if (!is_current(task)) return;
+
+					state.running = true;
+				}
+
+				const auto start = std::chrono::high_resolution_clock::now();
+
+				auto again = false;
+				uint32_t generation{};
+				std::optional<std::chrono::high_resolution_clock::time_point> deferred_call;
+
+				{
+					in_async_task = true;
+					const auto _ = gsl::finally([&]()
+					{
+						in_async_task = false;
+
+						// Reschedules from here on queue their call themselves
+						std::lock_guard lock(state.call_mutex);
+						state.running = false;
+						deferred_call = std::exchange(state.deferred_call, std::nullopt);
+						generation = state.generation;
+					});
+
+					again = run_task(task);
+				}
+
+				// Not queued again before it finished, so a task never overlaps with itself
+				if (deferred_call)
+				{
+					// Rescheduled during the call, which left the next call to us
+					if (!state.pending || state.cancelled) return;
+
+					task.generation = generation;
+					task.next_call = std::max(*deferred_call, start + min_interval);
+				}
+				else if (again)
+				{
+					task.next_call = start + std::max(state.interval, min_interval);
+				}
+				else
+				{
+					return;
+				}
+
+				this->add(std::move(task));
+			}, lane);
+		}
+	};
+
 	task_pipeline pipelines[scheduler::pipeline::count];
+	async_pipeline async_tasks;
+
+	const game::native::dvar_t* budgets[scheduler::pipeline::count]{};
 }
 
 void scheduler::execute(const pipeline type)
 {
-	assert(type >= 0 && type < pipeline::count);
-	pipelines[type].execute();
+	assert(type >= 0 && type < pipeline::count && type != pipeline::async && type != pipeline::background);
+
+	const auto* budget = budgets[type];
+	const auto budget_ms = budget ? budget->current.value : 0.0f;
+
+	pipelines[type].execute(std::chrono::microseconds(static_cast<int64_t>(budget_ms * 1000.0f)));
+}
+
+void scheduler::dump_statistics()
+{
+	const std::pair<pipeline, const char*> frame_pipelines[] =
+	{
+		{pipeline::renderer, "renderer"},
+		{pipeline::server, "server"},
+		{pipeline::main, "main"},
+	};
+
+	for (const auto& [type, name] : frame_pipelines)
+	{
+		const auto& stats = pipelines[type].get_statistics();
+		const auto within_budget = stats.overruns[0].load();
+
+		console::info("%s: %llu budgeted frames, %llu over budget, %llu tasks deferred\n", name, stats.frames.load(),
+		              stats.frames.load() - within_budget, stats.deferred_tasks.load());
+
+		for (size_t i = 1; i < stats.overruns.size(); ++i)
+		{
+			const auto count = stats.overruns[i].load();
+			if (!count) continue;
+
+			if (i < std::size(overrun_bounds))
+			{
+				console::info("  overrun <= %lld us: %llu\n", overrun_bounds[i].count(), count);
+			}
+			else
+			{
+				console::info("  overrun > %lld us: %llu\n", overrun_bounds[i - 1].count(), count);
+			}
+		}
+	}
 }
 
 void scheduler::r_end_frame_stub()
@@ -111,53 +439,107 @@ void scheduler::main_frame_stub()
 	execute(pipeline::main);
 }
 
-void scheduler::schedule(const std::function<bool()>& callback, const pipeline type,
-	const std::chrono::milliseconds delay)
+scheduler::task_handle::task_handle(std::weak_ptr<task_state> state) : state_(std::move(state))
 {
-	assert(type >= 0 && type < pipeline::count);
-
-	task task;
-	task.handler = callback;
-	task.interval = delay;
-	task.last_call = std::chrono::high_resolution_clock::now();
-
-	pipelines[type].add(std::move(task));
 }
 
-void scheduler::loop(const std::function<void()>& callback, const pipeline type,
-	const std::chrono::milliseconds delay)
+void scheduler::coroutine::promise_type::unhandled_exception() noexcept
 {
-	schedule([callback]()
+	// Nobody awaits a detached coroutine, rethrowing would only leak its frame
+	try
+	{
+		throw;
+	}
+	catch (const std::exception& ex)
 	{
-		callback();
-		return cond_continue;
-	}, type, delay);
+		console::error("Scheduled coroutine failed: %s\n", ex.what());
+	}
+	catch (...)
+	{
+		console::error("Scheduled coroutine failed\n");
+	}
 }
 
-void scheduler::once(const std::function<void()>& callback, const pipeline type,
-	const std::chrono::milliseconds delay)
+void scheduler::task_handle::cancel() const
 {
-	schedule([callback]
-	{
-		callback();
-		return cond_end;
-	}, type, delay);
+	const auto state = this->state_.lock();
+	if (!state) return;
+
+	state->cancelled = true;
+	state->pending = false;
 }
 
-void scheduler::post_start()
+bool scheduler::task_handle::reschedule(const std::chrono::milliseconds delay) const
 {
-	thread = utils::thread::create_named_thread("Async Scheduler", []()
+	const auto state = this->state_.lock();
+	if (!state || !state->pending || state->cancelled) return false;
+
+	const auto next_call = std::chrono::high_resolution_clock::now() + delay;
+
+	if (state->type == pipeline::async || state->type == pipeline::background)
 	{
-		while (!kill)
+		std::lock_guard _(state->call_mutex);
+		const auto generation = ++state->generation;
+
+		if (state->running)
 		{
-			execute(pipeline::async);
-			std::this_thread::sleep_for(10ms);
+			state->deferred_call = next_call;
+			return true;
 		}
-	});
+
+		enqueue(state, generation, next_call);
+		return true;
+	}
+
+	const auto generation = ++state->generation;
+	enqueue(state, generation, next_call);
+	return true;
+}
+
+bool scheduler::task_handle::is_pending() const
+{
+	const auto state = this->state_.lock();
+	return state && state->pending && !state->cancelled;
+}
+
+void scheduler::enqueue(std::shared_ptr<task_state> state, const uint32_t generation,
+	const std::chrono::high_resolution_clock::time_point next_call)
+{
+	const auto type = state->type;
+	assert(type >= 0 && type < pipeline::count);
+
+	task task;
+	task.state = std::move(state);
+	task.generation = generation;
+	task.next_call = next_call;
+
+	if (type == pipeline::async || type == pipeline::background)
+	{
+		async_tasks.add(std::move(task));
+		return;
+	}
+
+	pipelines[type].add(std::move(task));
+}
+void scheduler::post_start()
+{
+	async_tasks.start();
 }
 
 void scheduler::post_load()
 {
+	budgets[pipeline::renderer] = game::native::Dvar_RegisterFloat("sched_rendererBudget", 2.0f, 0.0f, 100.0f,
+		game::native::DVAR_NONE, "Milliseconds per frame for scheduled renderer tasks, 0 = unlimited");
+	budgets[pipeline::server] = game::native::Dvar_RegisterFloat("sched_serverBudget", 2.0f, 0.0f, 100.0f,
+		game::native::DVAR_NONE, "Milliseconds per frame for scheduled server tasks, 0 = unlimited");
+	budgets[pipeline::main] = game::native::Dvar_RegisterFloat("sched_mainBudget", 2.0f, 0.0f, 100.0f,
+		game::native::DVAR_NONE, "Milliseconds per frame for scheduled main thread tasks, 0 = unlimited");
+
+	command::add("sched_stats", []()
+	{
+		dump_statistics();
+	});
+
 	utils::hook(SELECT_VALUE(0x44C7DB, 0x55688E), main_frame_stub, HOOK_CALL).install()->quick();
 
 	utils::hook(SELECT_VALUE(0x57F7F8, 0x4978E2), r_end_frame_stub, HOOK_CALL).install()->quick();
@@ -168,11 +550,7 @@ void scheduler::post_load()
 
 void scheduler::pre_destroy()
 {
-	kill = true;
-	if (thread.joinable())
-	{
-		thread.join();
-	}
+	async_tasks.stop();
 }
 
 REGISTER_MODULE(scheduler);
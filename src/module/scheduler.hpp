@@ -1,4 +1,5 @@
 #pragma once
+#include <utils/block_pool.hpp>
 
 class scheduler final : public module
 {
@@ -8,6 +9,9 @@ public:
 		// Asynchronuous pipeline, disconnected from the game
 		async = 0,
 
+		// Asynchronuous pipeline for long running jobs like file or network I/O
+		background,
+
 		// The game's rendering pipeline
 		renderer,
 
@@ -20,19 +24,272 @@ public:
 		count,
 	};
 
+	// Order of due tasks within a frame, once the pipeline's budget is used up the rest waits for the next one
+	enum class priority
+	{
+		// Runs in the frame it is due, regardless of the budget
+		high,
+		normal,
+		low,
+	};
+
+	static constexpr bool cond_continue = false;
+	static constexpr bool cond_end = true;
+
+	// State shared by a scheduled task and its handles
+	class task_state
+	{
+	public:
+		task_state(const pipeline type, const std::chrono::milliseconds interval, const priority level)
+			: type(type), interval(interval), level(level)
+		{
+		}
+
+		virtual ~task_state() = default;
+
+		// Returns cond_end once the task is done
+		virtual bool run() = 0;
+
+		const pipeline type;
+		const std::chrono::milliseconds interval;
+		const priority level;
+
+		std::atomic<bool> pending{true};
+		std::atomic<bool> cancelled{false};
+
+		// Bumped by reschedule, queued calls of an older generation are skipped
+		std::atomic<uint32_t> generation{0};
+
+		// Async calls run on pool workers. A reschedule while one is running leaves
+		// the new due time here, the worker queues it once the call returned.
+		std::mutex call_mutex;
+		bool running = false;
+		std::optional<std::chrono::high_resolution_clock::time_point> deferred_call;
+	};
+
+	// Refers to a scheduled task without keeping it alive
+	class task_handle final
+	{
+	public:
+		task_handle() = default;
+
+		// The task won't be called again, a call in progress still finishes
+		void cancel() const;
+
+		// Moves the next call to delay from now, returns false if the task is no longer pending.
+		// A call in progress finishes first, the task never overlaps with itself.
+		bool reschedule(std::chrono::milliseconds delay) const;
+
+		bool is_pending() const;
+
+	private:
+		friend scheduler;
+		explicit task_handle(std::weak_ptr<task_state> state);
+
+		std::weak_ptr<task_state> state_;
+	};
+
+	// Return type of coroutines driven by the scheduler. They start on the calling thread,
+	// run detached and count as async until their first co_await on().
+	class coroutine final
+	{
+	public:
+		struct promise_type
+		{
+			pipeline current = pipeline::async;
+
+			coroutine get_return_object() noexcept { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() noexcept {}
+			void unhandled_exception() noexcept;
+
+			static void* operator new(const size_t size)
+			{
+				return utils::block_pool::allocate(size);
+			}
+
+			static void operator delete(void* data, const size_t size)
+			{
+				utils::block_pool::free(data, size);
+			}
+		};
+
+		using handle = std::coroutine_handle<promise_type>;
+	};
+
+	// Continues the coroutine in a later frame of a pipeline
+	class resume_awaiter final
+	{
+	public:
+		resume_awaiter(const std::optional<pipeline> type, const std::chrono::milliseconds delay)
+			: type_(type), delay_(delay)
+		{
+		}
+
+		bool await_ready() const noexcept { return false; }
+		void await_resume() const noexcept {}
+
+		void await_suspend(const coroutine::handle handle) const
+		{
+			auto& promise = handle.promise();
+			if (this->type_) promise.current = *this->type_;
+
+			// The coroutine may be running on the other thread as soon as it is queued
+			once([handle]
+			{
+				handle.resume();
+			}, promise.current, this->delay_);
+		}
+
+	private:
+		std::optional<pipeline> type_;
+		std::chrono::milliseconds delay_;
+	};
+
+	// Runs work on another pipeline and continues the coroutine with its result where it left off
+	template <typename F>
+	class offload_awaiter final
+	{
+	public:
+		using result_type = std::invoke_result_t<F&>;
+
+		offload_awaiter(F&& work, const pipeline type) : work_(std::move(work)), type_(type)
+		{
+		}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(const coroutine::handle handle)
+		{
+			once([this, handle, resume_on = handle.promise().current]
+			{
+				if constexpr (std::is_void_v<result_type>) this->work_();
+				else this->result_.emplace(this->work_());
+
+				once([handle]
+				{
+					handle.resume();
+				}, resume_on);
+			}, this->type_);
+		}
+
+		result_type await_resume()
+		{
+			if constexpr (!std::is_void_v<result_type>) return std::move(*this->result_);
+		}
+
+	private:
+		struct no_result
+		{
+		};
+
+		F work_;
+		pipeline type_;
+		std::optional<std::conditional_t<std::is_void_v<result_type>, no_result, result_type>> result_;
+	};
+
+	// co_await scheduler::on(pipeline::server) moves the coroutine to the server thread
+	static resume_awaiter on(const pipeline type)
+	{
+		return {type, 0ms};
+	}
+
+	static resume_awaiter sleep(const std::chrono::milliseconds delay)
+	{
+		return {{}, delay};
+	}
+
+	static resume_awaiter next_frame()
+	{
+		return {{}, 0ms};
+	}
+
+	// co_await scheduler::offload([] { return utils::io::read_file(path); }) keeps file access off the game threads
+	template <typename F>
+	static offload_awaiter<std::decay_t<F>> offload(F&& work, const pipeline type = pipeline::background)
+	{
+		return {std::decay_t<F>(std::forward<F>(work)), type};
+	}
+
 	void post_start() override;
 	void post_load() override;
 	void pre_destroy() override;
 
-	static void schedule(const std::function<bool()>& callback, pipeline type = pipeline::async,
-		std::chrono::milliseconds delay = 0ms);
-	static void loop(const std::function<void()>& callback, pipeline type = pipeline::async,
-		std::chrono::milliseconds delay = 0ms);
-	static void once(const std::function<void()>& callback, pipeline type = pipeline::async,
-		std::chrono::milliseconds delay = 0ms);
+	template <typename F>
+	static task_handle schedule(F&& callback, const pipeline type = pipeline::async,
+		const std::chrono::milliseconds delay = 0ms, const priority level = priority::normal)
+	{
+		return add<mode::schedule>(std::forward<F>(callback), type, delay, level);
+	}
+
+	template <typename F>
+	static task_handle loop(F&& callback, const pipeline type = pipeline::async,
+		const std::chrono::milliseconds delay = 0ms, const priority level = priority::normal)
+	{
+		return add<mode::loop>(std::forward<F>(callback), type, delay, level);
+	}
+
+	template <typename F>
+	static task_handle once(F&& callback, const pipeline type = pipeline::async,
+		const std::chrono::milliseconds delay = 0ms, const priority level = priority::normal)
+	{
+		return add<mode::once>(std::forward<F>(callback), type, delay, level);
+	}
 
 private:
+	enum class mode
+	{
+		schedule,
+		loop,
+		once,
+	};
+
+	// The callback is stored inline, next to the shared state in the same allocation
+	template <typename F, mode Mode>
+	class callback_task final : public task_state
+	{
+	public:
+		template <typename T>
+		callback_task(T&& callback, const pipeline type, const std::chrono::milliseconds interval, const priority level)
+			: task_state(type, interval, level), callback_(std::forward<T>(callback))
+		{
+		}
+
+		bool run() override
+		{
+			if constexpr (Mode == mode::schedule)
+			{
+				return this->callback_();
+			}
+			else
+			{
+				this->callback_();
+				return Mode == mode::once ? cond_end : cond_continue;
+			}
+		}
+
+	private:
+		F callback_;
+	};
+
+	template <mode Mode, typename F>
+	static task_handle add(F&& callback, const pipeline type, const std::chrono::milliseconds delay,
+		const priority level)
+	{
+		using task_type = callback_task<std::decay_t<F>, Mode>;
+
+		auto state = std::allocate_shared<task_type>(utils::pool_allocator<task_type>{}, std::forward<F>(callback), type,
+			delay, level);
+		enqueue(state, 0, std::chrono::high_resolution_clock::now() + delay);
+		return task_handle(state);
+	}
+
+	static void enqueue(std::shared_ptr<task_state> state, uint32_t generation,
+		std::chrono::high_resolution_clock::time_point next_call);
+
 	static void execute(const pipeline type);
+	static void dump_statistics();
 
 	static void r_end_frame_stub();
 	static void g_glass_update_stub();
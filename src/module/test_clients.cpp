@@ -106,32 +106,51 @@ void test_clients::gscr_add_test_client()
 	}
 }
 
+bool test_clients::is_test_client(const game::native::gentity_s* ent, const std::uint16_t port)
+{
+	// The bot may have been kicked, or its slot taken over, while the coroutine was waiting.
+	// The entity is the same for anyone in the slot, but every bot connects from its own port.
+	const auto num = ent->s.number;
+	if (num < 0 || num >= *game::native::svs_clientCount) return false;
+
+	const auto& client = game::native::mp::svs_clients[num];
+	return client.header.state >= game::native::CS_CONNECTED && client.bIsTestClient
+		&& client.header.netchan.remoteAddress.type == game::native::NA_BOT
+		&& client.header.netchan.remoteAddress.port == port;
+}
+
+scheduler::coroutine test_clients::spawn_bot(const std::chrono::milliseconds delay)
+{
+	co_await scheduler::on(scheduler::pipeline::server);
+	co_await scheduler::sleep(delay);
+
+	auto* ent = sv_add_test_client();
+	if (ent == nullptr) co_return;
+
+	game::native::Scr_AddEntityNum(ent->s.number, 0);
+
+	const auto port = game::native::mp::svs_clients[ent->s.number].header.netchan.remoteAddress.port;
+
+	co_await scheduler::sleep(1s);
+	if (!is_test_client(ent, port)) co_return;
+
+	game::native::Scr_AddString("autoassign");
+	game::native::Scr_AddString("team_marinesopfor");
+	game::native::Scr_Notify(ent, static_cast<std::uint16_t>(game::native::SL_GetString("menuresponse", 0)), 2);
+
+	co_await scheduler::sleep(2s);
+	if (!is_test_client(ent, port)) co_return;
+
+	game::native::Scr_AddString(utils::string::va("class%i", std::rand() % 5));
+	game::native::Scr_AddString("changeclass");
+	game::native::Scr_Notify(ent, static_cast<std::uint16_t>(game::native::SL_GetString("menuresponse", 0)), 2);
+}
+
 void test_clients::spawn(const int count)
 {
 	for (int i = 0; i < count; ++i)
 	{
-		scheduler::once([]
-		{
-			auto* ent = sv_add_test_client();
-			if (ent == nullptr) return;
-
-			game::native::Scr_AddEntityNum(ent->s.number, 0);
-			scheduler::once([ent]
-			{
-				game::native::Scr_AddString("autoassign");
-				game::native::Scr_AddString("team_marinesopfor");
-				game::native::Scr_Notify(ent, static_cast<std::uint16_t>(game::native::SL_GetString("menuresponse", 0)), 2);
-
-				scheduler::once([ent]
-				{
-					game::native::Scr_AddString(utils::string::va("class%i", std::rand() % 5));
-					game::native::Scr_AddString("changeclass");
-					game::native::Scr_Notify(ent, static_cast<std::uint16_t>(game::native::SL_GetString("menuresponse", 0)), 2);
-				}, scheduler::pipeline::server, 2s);
-
-			}, scheduler::pipeline::server, 1s);
-
-		}, scheduler::pipeline::server, 2s * (i + 1));
+		spawn_bot(2s * (i + 1));
 	}
 }
 
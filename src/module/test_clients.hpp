@@ -1,4 +1,5 @@
 #pragma once
+#include "scheduler.hpp"
 
 class test_clients final : public module
 {
@@ -13,6 +14,8 @@ private:
 	static bool can_add();
 	static game::native::gentity_s* sv_add_test_client();
 	static void gscr_add_test_client();
+	static bool is_test_client(const game::native::gentity_s* ent, std::uint16_t port);
+	static scheduler::coroutine spawn_bot(std::chrono::milliseconds delay);
 	static void spawn(int count);
 
 	static void scr_shutdown_system_mp_stub(unsigned char sys);
@@ -38,17 +38,26 @@
 #undef min
 #endif
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
 #include <filesystem>
 #include <format>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <list>
 #include <map>
 #include <mutex>
+#include <optional>
 #include <queue>
+#include <random>
 #include <regex>
+#include <shared_mutex>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <utility>
@@ -1,6 +1,5 @@
 #include <std_include.hpp>
 #include "steam/steam.hpp"
-#include "module/dw.hpp"
 
 namespace steam
 {
@@ -0,0 +1,82 @@
+#include <std_include.hpp>
+#include "block_pool.hpp"
+
+namespace utils
+{
+	namespace
+	{
+		// Size classes from 64 bytes to 4 KiB, larger blocks go straight to the heap
+		constexpr size_t min_block_size = 64;
+		constexpr size_t size_class_count = 7;
+
+		// Bounds what a burst can leave cached per size class
+		constexpr size_t max_cached_blocks = 256;
+
+		struct free_list
+		{
+			std::mutex mutex;
+			std::vector<void*> blocks;
+		};
+
+		free_list& get_free_list(const size_t size_class)
+		{
+			// Never destroyed, blocks can still come back during static destruction
+			static auto* lists = new free_list[size_class_count];
+			return lists[size_class];
+		}
+
+		size_t get_size_class(const size_t size)
+		{
+			size_t size_class = 0;
+			while (size_class < size_class_count && (min_block_size << size_class) < size)
+			{
+				++size_class;
+			}
+
+			return size_class;
+		}
+	}
+
+	void* block_pool::allocate(const size_t size)
+	{
+		const auto size_class = get_size_class(size);
+		if (size_class == size_class_count)
+		{
+			return ::operator new(size);
+		}
+
+		auto& list = get_free_list(size_class);
+
+		{
+			std::lock_guard _(list.mutex);
+			if (!list.blocks.empty())
+			{
+				const auto block = list.blocks.back();
+				list.blocks.pop_back();
+				return block;
+			}
+		}
+
+		return ::operator new(min_block_size << size_class);
+	}
+
+	void block_pool::free(void* data, const size_t size)
+	{
+		if (!data) return;
+
+		const auto size_class = get_size_class(size);
+		if (size_class < size_class_count)
+		{
+			auto& list = get_free_list(size_class);
+
+			std::lock_guard _(list.mutex);
+			if (list.blocks.size() < max_cached_blocks)
+			{
+				list.blocks.push_back(data);
+				return;
+			}
+		}
+
+		::operator delete(data);
+	}
+}
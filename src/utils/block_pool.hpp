@@ -0,0 +1,43 @@
+#pragma once
+
+namespace utils
+{
+	// Recycles small blocks through per-size free lists, for short-lived
+	// objects that are created at a high rate, like coroutine frames
+	class block_pool final
+	{
+	public:
+		static void* allocate(size_t size);
+		static void free(void* data, size_t size);
+	};
+
+	template <typename T>
+	class pool_allocator final
+	{
+	public:
+		using value_type = T;
+
+		pool_allocator() = default;
+
+		template <typename U>
+		pool_allocator(const pool_allocator<U>&) noexcept
+		{
+		}
+
+		T* allocate(const size_t count)
+		{
+			return static_cast<T*>(block_pool::allocate(count * sizeof(T)));
+		}
+
+		void deallocate(T* data, const size_t count) noexcept
+		{
+			block_pool::free(data, count * sizeof(T));
+		}
+
+		template <typename U>
+		bool operator==(const pool_allocator<U>&) const noexcept
+		{
+			return true;
+		}
+	};
+}
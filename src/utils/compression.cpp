@@ -71,6 +71,7 @@ namespace utils::compression
 
 		auto* buffer = allocator.allocate_array<char>(bound);
 		const auto size = ZSTD_compress(buffer, bound, data.data(), data.size(), ZSTD_maxCLevel());
+		if (ZSTD_isError(size)) return {};
 
 		return std::string(buffer, size);
 	}
@@ -78,10 +79,15 @@ namespace utils::compression
 	std::string zstd::decompress(const std::string& data)
 	{
 		memory::allocator allocator;
-		const auto bound = size_t(ZSTD_getFrameContentSize(data.data(), data.size()));
+		const auto content_size = ZSTD_getFrameContentSize(data.data(), data.size());
+		if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN) return {};
+
+		const auto bound = size_t(content_size);
+		if (!bound) return {};
 
 		auto* buffer = allocator.allocate_array<char>(bound);
 		const auto size = ZSTD_decompress(buffer, bound, data.data(), data.size());
+		if (ZSTD_isError(size)) return {};
 
 		return std::string(buffer, size);
 	}
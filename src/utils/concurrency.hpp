@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace utils::concurrency
 {
@@ -43,4 +48,186 @@ namespace utils::concurrency
 		mutable MutexType mutex_{};
 		T object_{};
 	};
+
+	// Unbounded lock-free queue for any number of producers and a single consumer.
+	// A push racing with try_pop may only become visible on the next try_pop.
+	template <typename T>
+	class mpsc_queue final
+	{
+	public:
+		mpsc_queue()
+		{
+			this->tail_ = new node;
+			this->head_ = this->tail_;
+		}
+
+		~mpsc_queue()
+		{
+			while (this->tail_)
+			{
+				const auto next = this->tail_->next.load(std::memory_order_relaxed);
+				delete this->tail_;
+				this->tail_ = next;
+			}
+		}
+
+		mpsc_queue(mpsc_queue&&) = delete;
+		mpsc_queue(const mpsc_queue&) = delete;
+		mpsc_queue& operator=(mpsc_queue&&) = delete;
+		mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+		void push(T value)
+		{
+			auto* entry = new node;
+			entry->value.emplace(std::move(value));
+
+			const auto previous = this->head_.exchange(entry, std::memory_order_acq_rel);
+			previous->next.store(entry, std::memory_order_release);
+		}
+
+		bool try_pop(T* value)
+		{
+			const auto next = this->tail_->next.load(std::memory_order_acquire);
+			if (!next) return false;
+
+			*value = std::move(*next->value);
+			next->value.reset();
+
+			delete this->tail_;
+			this->tail_ = next;
+			return true;
+		}
+
+		bool empty() const
+		{
+			return !this->tail_->next.load(std::memory_order_acquire);
+		}
+
+	private:
+		struct node
+		{
+			std::atomic<node*> next{nullptr};
+			std::optional<T> value;
+		};
+
+		std::atomic<node*> head_;
+		node* tail_;
+	};
+
+	// Hash map split into independently locked shards, so threads working
+	// on different keys rarely wait for each other
+	template <typename Key, typename Value, size_t Shards = 16, typename Hash = std::hash<Key>>
+	class sharded_map final
+	{
+	public:
+		std::optional<Value> find(const Key& key) const
+		{
+			const auto& shard = this->get_shard(key);
+			std::shared_lock _(shard.mutex);
+
+			const auto entry = shard.entries.find(key);
+			if (entry != shard.entries.end())
+			{
+				return entry->second;
+			}
+
+			return {};
+		}
+
+		// Runs the accessor on the key's value under the shard lock, returns whether the value was created
+		template <typename F>
+		bool access(const Key& key, F&& accessor)
+		{
+			auto& shard = this->get_shard(key);
+			std::lock_guard _(shard.mutex);
+
+			const auto result = shard.entries.try_emplace(key);
+			accessor(result.first->second);
+			return result.second;
+		}
+
+		bool erase(const Key& key)
+		{
+			auto& shard = this->get_shard(key);
+			std::lock_guard _(shard.mutex);
+			return shard.entries.erase(key) != 0;
+		}
+
+		void clear()
+		{
+			for (auto& shard : this->shards_)
+			{
+				std::lock_guard _(shard.mutex);
+				shard.entries.clear();
+			}
+		}
+
+		size_t size() const
+		{
+			size_t size = 0;
+			for (const auto& shard : this->shards_)
+			{
+				std::shared_lock _(shard.mutex);
+				size += shard.entries.size();
+			}
+
+			return size;
+		}
+
+	private:
+		struct alignas(64) shard
+		{
+			mutable std::shared_mutex mutex;
+			std::unordered_map<Key, Value, Hash> entries;
+		};
+
+		std::array<shard, Shards> shards_;
+
+		shard& get_shard(const Key& key)
+		{
+			return this->shards_[get_index(key)];
+		}
+
+		const shard& get_shard(const Key& key) const
+		{
+			return this->shards_[get_index(key)];
+		}
+
+		static size_t get_index(const Key& key)
+		{
+			// Some hashes are the identity, keep aligned keys from piling up in a few shards
+			return static_cast<size_t>((static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull) >> 32) % Shards;
+		}
+	};
+
+	// Counting filter over integer keys. may_contain never misses a key that was added,
+	// a false positive only costs the caller the exact lookup it would have done anyway.
+	template <size_t Buckets = 4096>
+	class counting_filter final
+	{
+	public:
+		void add(const size_t key)
+		{
+			this->buckets_[get_bucket(key)].fetch_add(1, std::memory_order_release);
+		}
+
+		void remove(const size_t key)
+		{
+			this->buckets_[get_bucket(key)].fetch_sub(1, std::memory_order_release);
+		}
+
+		bool may_contain(const size_t key) const
+		{
+			return this->buckets_[get_bucket(key)].load(std::memory_order_acquire) != 0;
+		}
+
+	private:
+		std::array<std::atomic<uint32_t>, Buckets> buckets_{};
+
+		static size_t get_bucket(const size_t key)
+		{
+			// Handles and addresses share their low bits, spread them with a Fibonacci hash
+			return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) % Buckets;
+		}
+	};
 }
@@ -165,24 +165,22 @@ namespace utils::cryptography
 
 	void rsa::initialize()
 	{
-		static auto initialized = false;
-		if (initialized) return;
-		initialized = true;
-
-		ltc_mp = ltm_desc;
-		register_hash(&sha1_desc);
-		register_prng(&yarrow_desc);
+		static std::once_flag initialized;
+		std::call_once(initialized, []()
+		{
+			ltc_mp = ltm_desc;
+			register_hash(&sha1_desc);
+			register_prng(&yarrow_desc);
+		});
 	}
 
 	std::string des3::encrypt(const std::string& data, const std::string& iv, const std::string& key)
 	{
-		initialize();
-
 		std::string enc_data;
 		enc_data.resize(data.size());
 
 		symmetric_CBC cbc;
-		const auto des3 = find_cipher("3des");
+		const auto des3 = get_cipher();
 
 		cbc_start(des3, reinterpret_cast<const uint8_t*>(iv.data()), reinterpret_cast<const uint8_t*>(key.data()),
 		          key.size(), 0, &cbc);
@@ -195,30 +193,67 @@ namespace utils::cryptography
 
 	std::string des3::decrypt(const std::string& data, const std::string& iv, const std::string& key)
 	{
-		initialize();
+		return decrypt(reinterpret_cast<const uint8_t*>(data.data()), data.size(), iv, key);
+	}
 
+	std::string des3::decrypt(const uint8_t* data, const size_t length, const std::string& iv, const std::string& key)
+	{
 		std::string dec_data;
-		dec_data.resize(data.size());
+		dec_data.resize(length);
 
 		symmetric_CBC cbc;
-		const auto des3 = find_cipher("3des");
+		const auto des3 = get_cipher();
 
 		cbc_start(des3, reinterpret_cast<const uint8_t*>(iv.data()), reinterpret_cast<const uint8_t*>(key.data()),
 		          key.size(), 0, &cbc);
-		cbc_decrypt(reinterpret_cast<const uint8_t*>(data.data()),
-		            reinterpret_cast<uint8_t*>(dec_data.data()), data.size(), &cbc);
+		cbc_decrypt(data, reinterpret_cast<uint8_t*>(dec_data.data()), length, &cbc);
 		cbc_done(&cbc);
 
 		return dec_data;
 	}
 
-	void des3::initialize()
+	des3::context::context(const std::string& key)
+	{
+		this->set_key(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+	}
+
+	void des3::context::set_key(const uint8_t* key, const size_t length)
+	{
+		const uint8_t iv[8]{};
+		this->valid_ = cbc_start(get_cipher(), iv, key, static_cast<int>(length), 0, &this->cbc_) == CRYPT_OK;
+	}
+
+	bool des3::context::is_valid() const
+	{
+		return this->valid_;
+	}
+
+	void des3::context::encrypt(const std::string& iv, const uint8_t* input, uint8_t* output, const size_t length) const
 	{
-		static auto initialized = false;
-		if (initialized) return;
-		initialized = true;
+		auto cbc = this->cbc_;
+		cbc_setiv(reinterpret_cast<const uint8_t*>(iv.data()), static_cast<unsigned long>(cbc.blocklen), &cbc);
+		cbc_encrypt(input, output, length, &cbc);
+		cbc_done(&cbc);
+	}
+
+	void des3::context::decrypt(const std::string& iv, const uint8_t* input, uint8_t* output, const size_t length) const
+	{
+		auto cbc = this->cbc_;
+		cbc_setiv(reinterpret_cast<const uint8_t*>(iv.data()), static_cast<unsigned long>(cbc.blocklen), &cbc);
+		cbc_decrypt(input, output, length, &cbc);
+		cbc_done(&cbc);
+	}
+
+	int des3::get_cipher()
+	{
+		// Sessions on different threads can get here first at the same time
+		static const auto cipher = []()
+		{
+			register_cipher(&des3_desc);
+			return find_cipher("3des");
+		}();
 
-		register_cipher(&des3_desc);
+		return cipher;
 	}
 
 	std::string tiger::compute(const std::string& data, const bool hex)
@@ -48,11 +48,30 @@ namespace utils::cryptography
 	class des3 final
 	{
 	public:
+		// Keeps the expanded key schedule around so it doesn't have to be rebuilt for every message
+		class context final
+		{
+		public:
+			context() = default;
+			explicit context(const std::string& key);
+
+			void set_key(const uint8_t* key, size_t length);
+			bool is_valid() const;
+
+			void encrypt(const std::string& iv, const uint8_t* input, uint8_t* output, size_t length) const;
+			void decrypt(const std::string& iv, const uint8_t* input, uint8_t* output, size_t length) const;
+
+		private:
+			bool valid_ = false;
+			symmetric_CBC cbc_{};
+		};
+
 		static std::string encrypt(const std::string& data, const std::string& iv, const std::string& key);
 		static std::string decrypt(const std::string& data, const std::string& iv, const std::string& key);
+		static std::string decrypt(const uint8_t* data, size_t length, const std::string& iv, const std::string& key);
 
 	private:
-		static void initialize();
+		static int get_cipher();
 	};
 
 	class tiger final
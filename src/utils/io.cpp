@@ -23,7 +23,7 @@ namespace utils::io
 		{
 			stream.write(data.data(), data.size());
 			stream.close();
-			return true;
+			return !stream.fail();
 		}
 
 		return false;
@@ -104,4 +104,97 @@ namespace utils::io
 
 		return files;
 	}
+
+	mapped_file::mapped_file(const std::string& file)
+	{
+		this->file_ = CreateFileA(file.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		                          FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (this->file_ == INVALID_HANDLE_VALUE) return;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(this->file_, &size) || !size.QuadPart || uint64_t(size.QuadPart) > SIZE_MAX)
+		{
+			this->release();
+			return;
+		}
+
+		this->mapping_ = CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!this->mapping_)
+		{
+			this->release();
+			return;
+		}
+
+		this->data_ = static_cast<const char*>(MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0));
+		if (!this->data_)
+		{
+			this->release();
+			return;
+		}
+
+		this->size_ = size_t(size.QuadPart);
+	}
+
+	mapped_file::~mapped_file()
+	{
+		this->release();
+	}
+
+	mapped_file::mapped_file(mapped_file&& obj) noexcept
+	{
+		this->operator=(std::move(obj));
+	}
+
+	mapped_file& mapped_file::operator=(mapped_file&& obj) noexcept
+	{
+		if (this != &obj)
+		{
+			this->release();
+
+			this->file_ = obj.file_;
+			this->mapping_ = obj.mapping_;
+			this->data_ = obj.data_;
+			this->size_ = obj.size_;
+
+			obj.file_ = INVALID_HANDLE_VALUE;
+			obj.mapping_ = nullptr;
+			obj.data_ = nullptr;
+			obj.size_ = 0;
+		}
+
+		return *this;
+	}
+
+	bool mapped_file::is_valid() const
+	{
+		return this->data_ != nullptr;
+	}
+
+	std::string_view mapped_file::get_data() const
+	{
+		return {this->data_, this->size_};
+	}
+
+	void mapped_file::release()
+	{
+		if (this->data_)
+		{
+			UnmapViewOfFile(this->data_);
+			this->data_ = nullptr;
+		}
+
+		if (this->mapping_)
+		{
+			CloseHandle(this->mapping_);
+			this->mapping_ = nullptr;
+		}
+
+		if (this->file_ != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(this->file_);
+			this->file_ = INVALID_HANDLE_VALUE;
+		}
+
+		this->size_ = 0;
+	}
 }
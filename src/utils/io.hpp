@@ -11,4 +11,30 @@ namespace utils::io
 	bool directory_exists(const std::string& directory);
 	bool directory_is_empty(const std::string& directory);
 	std::vector<std::string> list_files(const std::string& directory);
+
+	// Read-only view of a file mapped into memory
+	class mapped_file final
+	{
+	public:
+		mapped_file() = default;
+		explicit mapped_file(const std::string& file);
+		~mapped_file();
+
+		mapped_file(mapped_file&& obj) noexcept;
+		mapped_file& operator=(mapped_file&& obj) noexcept;
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool is_valid() const;
+		std::string_view get_data() const;
+
+	private:
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+		const char* data_ = nullptr;
+		size_t size_ = 0;
+
+		void release();
+	};
 }
@@ -0,0 +1,95 @@
+#include <std_include.hpp>
+#include "thread_pool.hpp"
+#include "thread.hpp"
+#include "string.hpp"
+
+namespace utils
+{
+	thread_pool::thread_pool(const std::string& name, const size_t thread_count) : name_(name)
+	{
+		for (size_t i = 0; i < std::max(thread_count, size_t(1)); ++i)
+		{
+			this->threads_.emplace_back(thread::create_named_thread(string::va("%s %zu", name.data(), i), [this]()
+			{
+				this->worker();
+			}));
+		}
+	}
+
+	thread_pool::~thread_pool()
+	{
+		this->stop();
+	}
+
+	void thread_pool::submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			if (this->stopped_) return;
+
+			this->tasks_.emplace(std::move(task));
+		}
+
+		this->signal_.notify_one();
+	}
+
+	void thread_pool::stop()
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->stopped_ = true;
+		}
+
+		this->signal_.notify_all();
+
+		for (auto& thread : this->threads_)
+		{
+			if (thread.joinable())
+			{
+				thread.join();
+			}
+		}
+
+		this->threads_.clear();
+	}
+
+	size_t thread_pool::get_thread_count() const
+	{
+		return this->threads_.size();
+	}
+
+	void thread_pool::worker()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+
+			{
+				std::unique_lock lock(this->mutex_);
+				this->signal_.wait(lock, [this]()
+				{
+					return this->stopped_ || !this->tasks_.empty();
+				});
+
+				if (this->tasks_.empty()) return;
+
+				task = std::move(this->tasks_.front());
+				this->tasks_.pop();
+			}
+
+			// One failing task must not take the process down with it
+			try
+			{
+				task();
+			}
+			catch (std::exception& e)
+			{
+				printf("%s: %s\n", this->name_.data(), e.what());
+			}
+			catch (...)
+			{
+				printf("%s: Unknown exception\n", this->name_.data());
+			}
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+namespace utils
+{
+	class thread_pool final
+	{
+	public:
+		thread_pool(const std::string& name, size_t thread_count);
+		~thread_pool();
+
+		thread_pool(thread_pool&&) = delete;
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(thread_pool&&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		void submit(std::function<void()> task);
+		void stop();
+
+		size_t get_thread_count() const;
+
+	private:
+		std::string name_;
+		bool stopped_ = false;
+		std::mutex mutex_;
+		std::condition_variable signal_;
+		std::queue<std::function<void()>> tasks_;
+		std::vector<std::thread> threads_;
+
+		void worker();
+	};
+}
@@ -0,0 +1,168 @@
+#include <std_include.hpp>
+#include "work_stealing_pool.hpp"
+#include "thread.hpp"
+#include "string.hpp"
+
+namespace utils
+{
+	namespace
+	{
+		// Lets tasks submitted from a worker land in that worker's own queue
+		thread_local const void* current_group = nullptr;
+		thread_local size_t current_queue = 0;
+	}
+
+	work_stealing_pool::work_stealing_pool(const std::string& name, const size_t thread_count,
+	                                       const size_t background_thread_count)
+	{
+		this->start_workers(name, lane::normal, thread_count);
+		this->start_workers(name + " Background", lane::background, background_thread_count);
+	}
+
+	work_stealing_pool::~work_stealing_pool()
+	{
+		this->stop();
+	}
+
+	void work_stealing_pool::submit(std::function<void()> task, const lane lane)
+	{
+		if (this->stopped_) return;
+
+		auto& group = this->groups_[static_cast<size_t>(lane)];
+		group.name = name;
+		const auto index = current_group == &group
+			                   ? current_queue
+			                   : group.next_queue.fetch_add(1, std::memory_order_relaxed) % group.queues.size();
+
+		{
+			auto& queue = *group.queues[index];
+			std::lock_guard _(queue.mutex);
+			queue.tasks.emplace_back(std::move(task));
+		}
+
+		{
+			std::lock_guard _(group.mutex);
+			++group.pending;
+		}
+
+		group.signal.notify_one();
+	}
+
+	void work_stealing_pool::stop()
+	{
+		this->stopped_ = true;
+
+		for (auto& group : this->groups_)
+		{
+			{
+				// Workers check the flag under this lock before they sleep
+				std::lock_guard _(group.mutex);
+			}
+
+			group.signal.notify_all();
+		}
+
+		for (auto& thread : this->threads_)
+		{
+			if (thread.joinable())
+			{
+				thread.join();
+			}
+		}
+
+		this->threads_.clear();
+	}
+
+	size_t work_stealing_pool::get_thread_count() const
+	{
+		return this->threads_.size();
+	}
+
+	void work_stealing_pool::start_workers(const std::string& name, const lane lane, const size_t thread_count)
+	{
+		auto& group = this->groups_[static_cast<size_t>(lane)];
+		group.name = name;
+
+		const auto count = std::max(thread_count, size_t(1));
+		for (size_t i = 0; i < count; ++i)
+		{
+			group.queues.push_back(std::make_unique<queue>());
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			this->threads_.emplace_back(thread::create_named_thread(string::va("%s %zu", name.data(), i), [this, &group, i]()
+			{
+				this->worker(group, i);
+			}));
+		}
+	}
+
+	void work_stealing_pool::worker(group& group, const size_t index)
+	{
+		current_group = &group;
+		current_queue = index;
+
+		std::function<void()> task;
+
+		while (true)
+		{
+			if (try_pop(group, index, &task))
+			{
+				try
+				{
+					task();
+				}
+				catch (std::exception& e)
+				{
+					printf("%s: %s\n", group.name.data(), e.what());
+				}
+				catch (...)
+				{
+					printf("%s: Unknown exception\n", group.name.data());
+				}
+
+				task = nullptr;
+				continue;
+			}
+
+			std::unique_lock lock(group.mutex);
+			group.signal.wait(lock, [this, &group]()
+			{
+				return this->stopped_ || group.pending > 0;
+			});
+
+			if (this->stopped_) return;
+		}
+	}
+
+	bool work_stealing_pool::try_pop(group& group, const size_t index, std::function<void()>* task)
+	{
+		const auto count = group.queues.size();
+
+		// The own queue is worked oldest first, thieves take the newest tasks from the others
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& queue = *group.queues[(index + i) % count];
+			std::lock_guard _(queue.mutex);
+
+			if (queue.tasks.empty()) continue;
+
+			if (i == 0)
+			{
+				*task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			else
+			{
+				*task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+
+			--group.pending;
+			return true;
+		}
+
+		return false;
+	}
+}
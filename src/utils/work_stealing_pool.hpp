@@ -0,0 +1,59 @@
+#pragma once
+
+namespace utils
+{
+	// Every worker owns a queue and idle workers steal from the others, waking on submit.
+	// Background tasks get their own workers, so long blocking jobs never hold up short ones.
+	class work_stealing_pool final
+	{
+	public:
+		enum class lane
+		{
+			normal,
+			background,
+			count,
+		};
+
+		work_stealing_pool(const std::string& name, size_t thread_count, size_t background_thread_count);
+		~work_stealing_pool();
+
+		work_stealing_pool(work_stealing_pool&&) = delete;
+		work_stealing_pool(const work_stealing_pool&) = delete;
+		work_stealing_pool& operator=(work_stealing_pool&&) = delete;
+		work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+		void submit(std::function<void()> task, lane lane = lane::normal);
+
+		// Lets running tasks finish, tasks that haven't started are dropped
+		void stop();
+
+		size_t get_thread_count() const;
+
+	private:
+		struct queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()>> tasks;
+		};
+
+		// The workers of one lane
+		struct group
+		{
+			std::string name;
+			std::vector<std::unique_ptr<queue>> queues;
+			std::atomic<size_t> next_queue{0};
+
+			std::mutex mutex;
+			std::condition_variable signal;
+			std::atomic<size_t> pending{0};
+		};
+
+		std::atomic<bool> stopped_{false};
+		group groups_[static_cast<size_t>(lane::count)];
+		std::vector<std::thread> threads_;
+
+		void start_workers(const std::string& name, lane lane, size_t thread_count);
+		void worker(group& group, size_t index);
+		static bool try_pop(group& group, size_t index, std::function<void()>* task);
+	};
+}